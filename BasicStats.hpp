@@ -11,6 +11,60 @@
 #include <numeric>
 #include <cmath>
 #include <stdexcept>
+#include <thread>
+#include <exception>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <new>
+#include <deque>
+#include <condition_variable>
+#include <iterator>
+#include <fstream>
+#include <cctype>
+#include <cerrno>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define BASIC_STATS_HAS_COROUTINES 1
+#endif
+#endif
+#ifndef BASIC_STATS_HAS_COROUTINES
+#define BASIC_STATS_HAS_COROUTINES 0
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// Opcode probing arrived with IORING_OP_READ in Linux 5.6; older headers lack both.
+#ifdef IO_URING_OP_SUPPORTED
+#define BASIC_STATS_HAS_IO_URING 1
+#endif
+#endif
+#endif
+#endif
+#ifndef BASIC_STATS_HAS_IO_URING
+#define BASIC_STATS_HAS_IO_URING 0
+#endif
 
 namespace BasicStats
 {
@@ -56,6 +110,596 @@ namespace BasicStats
 		return std::pow(product, 1.0 / data.size());
 	}
 
+	/**
+	 * @brief Interface through which the parallel algorithms schedule their work.
+	 *
+	 * The library runs everything on one shared executor, a work-stealing
+	 * ThreadPool by default. A host application with its own pool can implement
+	 * this interface and install it with set_default_executor() so that the
+	 * library does not oversubscribe the machine.
+	 */
+	class Executor
+	{
+	public:
+		virtual ~Executor() = default;
+
+		/**
+		 * @brief The number of tasks the executor runs at once.
+		 */
+		virtual size_t concurrency() const = 0;
+
+		/**
+		 * @brief Run a task asynchronously. Tasks must not throw.
+		 *
+		 * @param task The task to run.
+		 * @param hint The preferred worker. Chunk c of a parallel loop is
+		 * submitted with hint c, so an executor that honours it gives each worker
+		 * the same slice of an array on every pass.
+		 */
+		virtual void execute(std::function<void()> task, size_t hint) = 0;
+
+		/**
+		 * @brief Run chunk c of a parallel loop split into C chunks. Tasks must not throw.
+		 *
+		 * The default forwards to execute(task, c). Executors whose workers are
+		 * not interchangeable override it to place a chunk by its position in the loop.
+		 *
+		 * @param task The task to run.
+		 * @param chunk The index c of the chunk.
+		 * @param chunks The number C of chunks in the loop.
+		 */
+		virtual void execute_chunk(std::function<void()> task, size_t chunk, size_t chunks)
+		{
+			(void)chunks;
+			execute(std::move(task), chunk);
+		}
+	};
+
+	/**
+	 * @brief Executor that runs every task on the calling thread.
+	 */
+	class InlineExecutor : public Executor
+	{
+	public:
+		size_t concurrency() const override { return 1; }
+		void execute(std::function<void()> task, size_t) override { task(); }
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief Number of hardware threads.
+		 *
+		 * @return The hardware concurrency, or 1 if it cannot be determined.
+		 */
+		inline size_t hardware_threads()
+		{
+			unsigned int n = std::thread::hardware_concurrency();
+			return n == 0 ? 1 : n;
+		}
+
+		// The pool and worker index of the current thread, if it is a pool worker.
+		inline thread_local const void* current_pool = nullptr;
+		inline thread_local size_t current_worker = 0;
+	}
+
+	/**
+	 * @brief Work-stealing thread pool.
+	 *
+	 * Every worker owns a deque. Tasks submitted from outside the pool go to the
+	 * deque of the hinted worker and tasks submitted by a worker go to its own;
+	 * a worker takes its newest task first and, when its deque is empty, steals
+	 * the oldest task of another worker.
+	 */
+	class ThreadPool : public Executor
+	{
+	public:
+		/**
+		 * @brief Start the workers.
+		 *
+		 * @param threads The number of workers.
+		 * @param on_start Called on each worker thread with its index before it runs any task, e.g. to pin it.
+		 */
+		explicit ThreadPool(size_t threads = detail::hardware_threads(), std::function<void(size_t)> on_start = nullptr)
+		{
+			threads = std::max<size_t>(threads, 1);
+			for (size_t i = 0; i < threads; ++i) queues_.push_back(std::make_unique<Queue>());
+			workers_.reserve(threads);
+			for (size_t i = 0; i < threads; ++i)
+			{
+				workers_.emplace_back([this, i, on_start]() {
+					if (on_start) on_start(i);
+					run(i);
+				});
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/**
+		 * @brief Finish every queued task, then stop the workers.
+		 */
+		~ThreadPool() override
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			wake_.notify_all();
+			for (std::thread& worker : workers_) worker.join();
+		}
+
+		size_t concurrency() const override { return workers_.size(); }
+
+		void execute(std::function<void()> task, size_t hint) override
+		{
+			size_t target = detail::current_pool == this ? detail::current_worker : hint % queues_.size();
+			{
+				std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+				queues_[target]->tasks.push_back(std::move(task));
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				++pending_;
+			}
+			wake_.notify_one();
+		}
+
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		bool pop(size_t index, std::function<void()>& task)
+		{
+			for (size_t k = 0; k < queues_.size(); ++k)
+			{
+				Queue& queue = *queues_[(index + k) % queues_.size()];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (queue.tasks.empty()) continue;
+				if (k == 0)
+				{
+					task = std::move(queue.tasks.back());
+					queue.tasks.pop_back();
+				}
+				else
+				{
+					task = std::move(queue.tasks.front());
+					queue.tasks.pop_front();
+				}
+				pending_.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+			return false;
+		}
+
+		void run(size_t index)
+		{
+			detail::current_pool = this;
+			detail::current_worker = index;
+			std::function<void()> task;
+			while (true)
+			{
+				if (pop(index, task))
+				{
+					task();
+					task = nullptr;
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait(lock, [this]() { return stopping_ || pending_.load(std::memory_order_relaxed) > 0; });
+				if (stopping_ && pending_.load(std::memory_order_relaxed) == 0) return;
+			}
+		}
+
+		std::vector<std::unique_ptr<Queue>> queues_;
+		std::vector<std::thread> workers_;
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::atomic<size_t> pending_{ 0 };
+		bool stopping_ = false;
+	};
+
+	namespace detail
+	{
+		struct ExecutorRegistry
+		{
+			std::mutex mutex;
+			std::shared_ptr<Executor> executor;
+		};
+
+		inline ExecutorRegistry& executor_registry()
+		{
+			static ExecutorRegistry registry;
+			return registry;
+		}
+	}
+
+	/**
+	 * @brief The executor used by every parallel algorithm.
+	 *
+	 * @return The installed executor, or a ThreadPool with one worker per
+	 * hardware thread, created on first use.
+	 */
+	inline std::shared_ptr<Executor> default_executor()
+	{
+		detail::ExecutorRegistry& registry = detail::executor_registry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		if (!registry.executor) registry.executor = std::make_shared<ThreadPool>();
+		return registry.executor;
+	}
+
+	/**
+	 * @brief Install the executor used by every parallel algorithm.
+	 *
+	 * Calls already running keep the executor they started with.
+	 *
+	 * @param executor The executor, or null to go back to the built-in pool.
+	 */
+	inline void set_default_executor(std::shared_ptr<Executor> executor)
+	{
+		detail::ExecutorRegistry& registry = detail::executor_registry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.executor = std::move(executor);
+	}
+
+	/**
+	 * @brief The parallel algorithms whose grain size can be tuned.
+	 */
+	enum class ParallelAlgorithm : size_t
+	{
+		reduce,       // single-pass reductions, in elements
+		index_build,  // RangeIndex and WaveletMatrix construction, in elements
+		sort,         // sorting, in elements
+		merge,        // tree_merge, in partial states
+		bootstrap     // bootstrap resampling, in replicates
+	};
+
+	namespace detail
+	{
+		inline std::atomic<size_t>& grain_entry(ParallelAlgorithm algorithm)
+		{
+			static std::atomic<size_t> grains[] = { { 1 << 16 }, { 1 << 16 }, { 1 << 15 }, { 256 }, { 16 } };
+			return grains[static_cast<size_t>(algorithm)];
+		}
+	}
+
+	/**
+	 * @brief The minimum amount of work per task for an algorithm.
+	 *
+	 * @param algorithm The algorithm.
+	 * @return The grain size; inputs smaller than two grains run serially.
+	 */
+	inline size_t grain_size(ParallelAlgorithm algorithm)
+	{
+		return detail::grain_entry(algorithm).load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Tune the minimum amount of work per task for an algorithm.
+	 *
+	 * @param algorithm The algorithm.
+	 * @param grain The new grain size (at least 1).
+	 */
+	inline void set_grain_size(ParallelAlgorithm algorithm, size_t grain)
+	{
+		detail::grain_entry(algorithm).store(std::max<size_t>(grain, 1), std::memory_order_relaxed);
+	}
+
+	namespace detail
+	{
+		/**
+		 * @brief Number of tasks the default executor runs at once.
+		 */
+		inline size_t worker_count()
+		{
+			return default_executor()->concurrency();
+		}
+
+		/**
+		 * @brief Number of elements of type T in a 4 KiB page.
+		 */
+		template<typename T>
+		constexpr size_t page_elements()
+		{
+			return std::max<size_t>(1, 4096 / sizeof(T));
+		}
+
+		/**
+		 * @brief Split [0, n) into contiguous chunks and run them on the default executor.
+		 *
+		 * Chunk c is submitted with hint c and its boundaries are multiples of
+		 * align, so with a page-sized align no page is split between chunks and
+		 * each worker keeps touching the same pages, which it first-touched itself.
+		 * The calling thread runs chunks too and takes over any chunk no worker has
+		 * started, so nested calls from inside pool tasks cannot deadlock. Inputs
+		 * smaller than two grains run serially. The first exception thrown by any
+		 * chunk is rethrown.
+		 *
+		 * @tparam Function Callable invoked as fn(begin, end).
+		 * @param n The number of items.
+		 * @param grain The minimum number of items per chunk.
+		 * @param fn The function to apply to each chunk.
+		 * @param align The multiple chunk boundaries are rounded to.
+		 */
+		template<typename Function>
+		void parallel_for(size_t n, size_t grain, Function fn, size_t align = 1)
+		{
+			if (n == 0) return;
+			grain = std::max<size_t>(grain, 1);
+			align = std::max<size_t>(align, 1);
+			std::shared_ptr<Executor> executor = default_executor();
+			size_t chunks = std::min(executor->concurrency(), (n + grain - 1) / grain);
+			size_t step = ((n + chunks - 1) / std::max<size_t>(chunks, 1) + align - 1) / align * align;
+			chunks = (n + step - 1) / step;
+			if (chunks <= 1)
+			{
+				fn(size_t(0), n);
+				return;
+			}
+
+			// Tasks may be scheduled after the call returns; they then find every
+			// chunk claimed and never touch fn.
+			struct State
+			{
+				explicit State(size_t chunks)
+					: claimed(new std::atomic<bool>[chunks]), errors(chunks)
+				{
+					for (size_t c = 0; c < chunks; ++c) claimed[c].store(false, std::memory_order_relaxed);
+				}
+
+				std::unique_ptr<std::atomic<bool>[]> claimed;
+				std::atomic<size_t> done{ 0 };
+				std::vector<std::exception_ptr> errors;
+			};
+			auto state = std::make_shared<State>(chunks);
+			auto run_chunk = [state, n, step, fnp = &fn](size_t c) {
+				if (state->claimed[c].exchange(true, std::memory_order_acq_rel)) return;
+				try { (*fnp)(c * step, std::min(n, (c + 1) * step)); }
+				catch (...) { state->errors[c] = std::current_exception(); }
+				state->done.fetch_add(1, std::memory_order_acq_rel);
+			};
+			for (size_t c = 0; c + 1 < chunks; ++c)
+			{
+				executor->execute_chunk([run_chunk, c, chunks]() {
+					run_chunk(c);
+					for (size_t k = 1; k < chunks; ++k) run_chunk((c + k) % chunks);
+				}, c, chunks);
+			}
+			for (size_t k = 0; k < chunks; ++k) run_chunk(chunks - 1 - k);
+			while (state->done.load(std::memory_order_acquire) < chunks) std::this_thread::yield();
+			for (const std::exception_ptr& error : state->errors)
+			{
+				if (error) std::rethrow_exception(error);
+			}
+		}
+	}
+
+	namespace detail
+	{
+		/**
+		 * @brief Calculate the median of an already sorted range.
+		 */
+		template<typename Iterator>
+		double sorted_median(Iterator first, Iterator last)
+		{
+			size_t n = static_cast<size_t>(last - first);
+			if (n == 0) return 0.0;
+			if (n % 2 == 0)
+				return (first[n / 2 - 1] + first[n / 2]) / 2.0;
+			else
+				return first[n / 2];
+		}
+
+		/**
+		 * @brief Calculate the first quartile of an already sorted range.
+		 */
+		template<typename Iterator>
+		double sorted_first_quartile(Iterator first, Iterator last)
+		{
+			size_t n = static_cast<size_t>(last - first);
+			if (n == 0) return 0.0;
+			if (n % 2 == 0)
+				return sorted_median(first, first + n / 2);
+			else
+				return sorted_median(first, first + n / 2 + 1);
+		}
+
+		/**
+		 * @brief Calculate the third quartile of an already sorted range.
+		 */
+		template<typename Iterator>
+		double sorted_third_quartile(Iterator first, Iterator last)
+		{
+			size_t n = static_cast<size_t>(last - first);
+			if (n == 0) return 0.0;
+			return sorted_median(first + n / 2, last);
+		}
+
+		/**
+		 * @brief Calculate a percentile (0-100) of an already sorted range using linear interpolation.
+		 */
+		template<typename Iterator>
+		double sorted_percentile(Iterator first, Iterator last, double p)
+		{
+			size_t n = static_cast<size_t>(last - first);
+			if (n == 0) return 0.0;
+			if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+			double rank = (p / 100) * (n - 1);
+			size_t lower = static_cast<size_t>(std::floor(rank));
+			size_t upper = static_cast<size_t>(std::ceil(rank));
+			double weight = rank - lower;
+			if (upper >= n) return first[lower];
+			return first[lower] + weight * (first[upper] - first[lower]);
+		}
+
+		/**
+		 * @brief Check whether a range is in non-decreasing order.
+		 *
+		 * Adjacent pairs are compared a block at a time without an early exit inside
+		 * the block, so the inner loop vectorises; the probe stops at the first
+		 * block containing a descent.
+		 */
+		template<typename Iterator>
+		bool is_sorted(Iterator first, Iterator last)
+		{
+			constexpr size_t block = 256;
+			size_t n = static_cast<size_t>(last - first);
+			for (size_t begin = 0; begin + 1 < n; begin += block)
+			{
+				size_t end = std::min(n - 1, begin + block);
+				bool descent = false;
+				for (size_t i = begin; i < end; ++i) descent |= first[i + 1] < first[i];
+				if (descent) return false;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief Sort a range, exploiting existing order.
+		 *
+		 * Ascending runs are detected and descending runs reversed, then the runs are
+		 * merged pairwise, which is O(n log r) for r runs and O(n) for sorted input.
+		 * Inputs with too many short runs fall back to std::sort.
+		 */
+		template<typename Iterator>
+		void adaptive_sort(Iterator first, Iterator last)
+		{
+			constexpr size_t min_average_run = 32;
+			size_t n = static_cast<size_t>(last - first);
+			if (n < 2) return;
+			std::vector<size_t> bounds{ 0 };
+			size_t i = 0;
+			while (i < n)
+			{
+				size_t j = i + 1;
+				if (j < n && first[j] < first[j - 1])
+				{
+					while (j < n && first[j] < first[j - 1]) ++j;
+					std::reverse(first + i, first + j);
+				}
+				else
+				{
+					while (j < n && !(first[j] < first[j - 1])) ++j;
+				}
+				bounds.push_back(j);
+				i = j;
+				if (bounds.size() > n / min_average_run + 2)
+				{
+					std::sort(first, last);
+					return;
+				}
+			}
+			while (bounds.size() > 2)
+			{
+				std::vector<size_t> merged{ 0 };
+				for (size_t r = 0; r + 2 < bounds.size(); r += 2)
+				{
+					std::inplace_merge(first + bounds[r], first + bounds[r + 1], first + bounds[r + 2]);
+					merged.push_back(bounds[r + 2]);
+				}
+				if (bounds.size() % 2 == 0) merged.push_back(bounds.back());
+				bounds.swap(merged);
+			}
+		}
+
+		/**
+		 * @brief Sort a range on the default executor.
+		 *
+		 * Equal slices are sorted with adaptive_sort in parallel, then merged
+		 * pairwise through a buffer, each round's merges running in parallel.
+		 * Ranges smaller than two sort grains are sorted serially.
+		 */
+		template<typename Iterator>
+		void parallel_sort(Iterator first, Iterator last)
+		{
+			using Value = typename std::iterator_traits<Iterator>::value_type;
+			size_t n = static_cast<size_t>(last - first);
+			size_t grain = grain_size(ParallelAlgorithm::sort);
+			size_t chunks = std::min(worker_count(), n / std::max<size_t>(grain, 1));
+			if (chunks < 2)
+			{
+				adaptive_sort(first, last);
+				return;
+			}
+			std::vector<size_t> bounds(chunks + 1);
+			for (size_t c = 0; c <= chunks; ++c) bounds[c] = c * n / chunks;
+			parallel_for(chunks, 1, [&](size_t cb, size_t ce) {
+				for (size_t c = cb; c < ce; ++c) adaptive_sort(first + bounds[c], first + bounds[c + 1]);
+			});
+
+			std::vector<Value> buffer(n);
+			auto round = [&](auto source, auto target) {
+				size_t runs = bounds.size() - 1;
+				parallel_for((runs + 1) / 2, 1, [&](size_t pb, size_t pe) {
+					for (size_t p = pb; p < pe; ++p)
+					{
+						size_t lo = bounds[2 * p], mid = bounds[std::min(2 * p + 1, runs)], hi = bounds[std::min(2 * p + 2, runs)];
+						std::merge(std::make_move_iterator(source + lo), std::make_move_iterator(source + mid),
+							std::make_move_iterator(source + mid), std::make_move_iterator(source + hi), target + lo);
+					}
+				});
+				std::vector<size_t> merged;
+				for (size_t r = 0; r < runs; r += 2) merged.push_back(bounds[r]);
+				merged.push_back(n);
+				bounds.swap(merged);
+			};
+			bool in_buffer = false;
+			while (bounds.size() > 2)
+			{
+				if (in_buffer)
+					round(buffer.begin(), first);
+				else
+					round(first, buffer.begin());
+				in_buffer = !in_buffer;
+			}
+			if (in_buffer) std::move(buffer.begin(), buffer.end(), first);
+		}
+
+		/**
+		 * @brief Get a vector in sorted order, copying and sorting it into storage
+		 * only when the probe finds it unsorted.
+		 *
+		 * @return Either data itself or storage holding its sorted copy.
+		 */
+		template<typename T>
+		const std::vector<T>& sorted_view(const std::vector<T>& data, std::vector<T>& storage)
+		{
+			if (detail::is_sorted(data.begin(), data.end())) return data;
+			storage = data;
+			parallel_sort(storage.begin(), storage.end());
+			return storage;
+		}
+	}
+
+	/**
+	 * @brief Tag type asserting that the input is already sorted in ascending order.
+	 *
+	 * Order-statistic overloads taking this tag neither copy nor sort their input.
+	 */
+	struct assume_sorted_t
+	{
+		explicit assume_sorted_t() = default;
+	};
+
+	inline constexpr assume_sorted_t assume_sorted{};
+
+	/**
+	 * @brief Check whether a vector of numbers is sorted in ascending order.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @return True if no element is smaller than its predecessor.
+	 */
+	template<typename T>
+	bool is_sorted(const std::vector<T>& data)
+	{
+		return detail::is_sorted(data.begin(), data.end());
+	}
+
 	/**
 	 * @brief Calculate the median of a vector of numbers.
 	 *
@@ -67,13 +711,22 @@ namespace BasicStats
 	double median(const std::vector<T>& data)
 	{
 		if (data.empty()) return 0.0;
-		std::vector<T> sorted_data = data;
-		std::sort(sorted_data.begin(), sorted_data.end());
-		size_t n = sorted_data.size();
-		if (n % 2 == 0)
-			return (sorted_data[n / 2 - 1] + sorted_data[n / 2]) / 2.0;
-		else
-			return sorted_data[n / 2];
+		std::vector<T> storage;
+		const std::vector<T>& sorted_data = detail::sorted_view(data, storage);
+		return detail::sorted_median(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the median of a vector of numbers that is already sorted.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers, in ascending order.
+	 * @return The median of the elements in the vector.
+	 */
+	template<typename T>
+	double median(assume_sorted_t, const std::vector<T>& data)
+	{
+		return detail::sorted_median(data.begin(), data.end());
 	}
 
 	/**
@@ -87,13 +740,22 @@ namespace BasicStats
 	double first_quartile(const std::vector<T>& data)
 	{
 		if (data.empty()) return 0.0;
-		std::vector<T> sorted_data = data;
-		std::sort(sorted_data.begin(), sorted_data.end());
-		size_t n = sorted_data.size();
-		if (n % 2 == 0)
-			return median(std::vector<T>(sorted_data.begin(), sorted_data.begin() + n / 2));
-		else
-			return median(std::vector<T>(sorted_data.begin(), sorted_data.begin() + n / 2 + 1));
+		std::vector<T> storage;
+		const std::vector<T>& sorted_data = detail::sorted_view(data, storage);
+		return detail::sorted_first_quartile(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the first quartile (Q1) of a vector of numbers that is already sorted.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers, in ascending order.
+	 * @return The first quartile of the elements in the vector.
+	 */
+	template<typename T>
+	double first_quartile(assume_sorted_t, const std::vector<T>& data)
+	{
+		return detail::sorted_first_quartile(data.begin(), data.end());
 	}
 
 	/**
@@ -107,10 +769,22 @@ namespace BasicStats
 	double third_quartile(const std::vector<T>& data)
 	{
 		if (data.empty()) return 0.0;
-		std::vector<T> sorted_data = data;
-		std::sort(sorted_data.begin(), sorted_data.end());
-		size_t n = sorted_data.size();
-		return median(std::vector<T>(sorted_data.begin() + n / 2, sorted_data.end()));
+		std::vector<T> storage;
+		const std::vector<T>& sorted_data = detail::sorted_view(data, storage);
+		return detail::sorted_third_quartile(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the third quartile (Q3) of a vector of numbers that is already sorted.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers, in ascending order.
+	 * @return The third quartile of the elements in the vector.
+	 */
+	template<typename T>
+	double third_quartile(assume_sorted_t, const std::vector<T>& data)
+	{
+		return detail::sorted_third_quartile(data.begin(), data.end());
 	}
 
 	/**
@@ -185,7 +859,23 @@ namespace BasicStats
 	double iqr(const std::vector<T>& data)
 	{
 		if (data.empty()) return 0.0;
-		return third_quartile(data) - first_quartile(data);
+		std::vector<T> storage;
+		const std::vector<T>& sorted_data = detail::sorted_view(data, storage);
+		return iqr(assume_sorted, sorted_data);
+	}
+
+	/**
+	 * @brief Calculate the interquartile range (IQR) of a vector of numbers that is already sorted.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers, in ascending order.
+	 * @return The interquartile range of the elements in the vector.
+	 */
+	template<typename T>
+	double iqr(assume_sorted_t, const std::vector<T>& data)
+	{
+		if (data.empty()) return 0.0;
+		return detail::sorted_third_quartile(data.begin(), data.end()) - detail::sorted_first_quartile(data.begin(), data.end());
 	}
 
 	/**
@@ -201,14 +891,23 @@ namespace BasicStats
 	{
 		if (data.empty()) return 0.0;
 		if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
-		std::vector<T> sorted_data = data;
-		std::sort(sorted_data.begin(), sorted_data.end());
-		double rank = (p / 100) * (sorted_data.size() - 1);
-		size_t lower = static_cast<size_t>(std::floor(rank));
-		size_t upper = static_cast<size_t>(std::ceil(rank));
-		double weight = rank - lower;
-		if (upper >= sorted_data.size()) return sorted_data[lower];
-		return sorted_data[lower] + weight * (sorted_data[upper] - sorted_data[lower]);
+		std::vector<T> storage;
+		const std::vector<T>& sorted_data = detail::sorted_view(data, storage);
+		return detail::sorted_percentile(sorted_data.begin(), sorted_data.end(), p);
+	}
+
+	/**
+	 * @brief Calculate the percentile of a vector of numbers that is already sorted.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers, in ascending order.
+	 * @param p The percentile to calculate (0-100).
+	 * @return The value at the specified percentile.
+	 */
+	template<typename T>
+	double percentile(assume_sorted_t, const std::vector<T>& data, double p)
+	{
+		return detail::sorted_percentile(data.begin(), data.end(), p);
 	}
 
 	/**
@@ -279,6 +978,49 @@ namespace BasicStats
 		return result;
 	}
 
+	namespace detail
+	{
+		/**
+		 * @brief Draw nmax bootstrap statistics, serially or on the default executor.
+		 *
+		 * The serial path calls the caller's func directly. The concurrent path
+		 * gives every chunk its own copy of func, so a functor with internal state
+		 * is never shared between threads.
+		 *
+		 * @tparam R The type the statistics are stored as.
+		 * @param draw Called as draw(func) for each statistic.
+		 */
+		template<typename R, bool Concurrent, typename Function, typename Draw>
+		std::vector<R> bootstrap_statistics(unsigned int nmax, Function& func, Draw draw)
+		{
+			std::vector<R> results(nmax);
+			if constexpr (Concurrent)
+			{
+				parallel_for(nmax, grain_size(ParallelAlgorithm::bootstrap), [&](size_t begin, size_t end) {
+					Function local(func);
+					for (size_t i = begin; i < end; ++i) results[i] = draw(local);
+				});
+			}
+			else
+			{
+				for (unsigned int i = 0; i < nmax; ++i) results[i] = draw(func);
+			}
+			return results;
+		}
+	}
+
+	/**
+	 * @brief Tag type requesting that an overload spread its work over the default executor.
+	 *
+	 * Overloads taking this tag call user functions concurrently; see each overload for the contract.
+	 */
+	struct parallel_t
+	{
+		explicit parallel_t() = default;
+	};
+
+	inline constexpr parallel_t parallel{};
+
 	/**
 	 * @brief Calculate the confidence interval of a statistic using bootstrap resampling.
 	 * 
@@ -295,50 +1037,7642 @@ namespace BasicStats
 		static_assert(std::is_invocable_r_v<double, Function, const std::vector<T>&>, "Function must return double and accept a vector of T.");
 		if (data.empty()) return { 0.0, 0.0 };
 		if (confidence_level <= 0 || confidence_level >= 100) throw std::out_of_range("Confidence level must be between 0 and 1.");
-		std::vector<T> result_vector;
-		for (unsigned int i = 0; i < nmax; ++i)
-		{
-			std::vector<T> resamepled_data = resample(data);
-			double result = func(resampled_data);
-			result_vector.push_back(result);
-		}
+		std::vector<T> result_vector = detail::bootstrap_statistics<T, false>(nmax, func, [&](Function& f) { return f(resample(data)); });
 		double min = percentile(result_vector, (100 - confidence_level) / 2);
 		double max = percentile(result_vector, 100 - (100 - confidence_level) / 2);
 		return { min, max };
 	}
 
 	/**
-	 * @brief Calculate the confidence interval of the difference between two statistics using bootstrap resampling.
-	 * 
+	 * @brief Calculate the confidence interval of a statistic using bootstrap resampling in parallel.
+	 *
+	 * The resamples are spread over the default executor. Each task works on
+	 * its own copy of func, so func must be copyable and its copies must be
+	 * safe to call from different threads at once.
+	 *
 	 * @tparam T The type of the elements in the vector.
-	 * @param data1 The first vector of numbers.
-	 * @param data2 The second vector of numbers.
+	 * @param data The vector of numbers.
 	 * @param func The function to apply to the resampled data.
 	 * @param confidence_level The confidence level (0-100).
 	 * @param nmax The number of bootstrap samples to generate.
 	 * @return A pair containing the lower and upper bounds of the confidence interval.
 	 */
 	template<typename T, typename Function>
-	std::pair<double, double> confidence_interval(const std::vector<T>& data1, const std::vector<T>& data2, Function func, double confidence_level, unsigned int nmax = 1024)
+	std::pair<double, double> confidence_interval(parallel_t, const std::vector<T>& data, Function func, double confidence_level, unsigned int nmax = 1024)
 	{
 		static_assert(std::is_invocable_r_v<double, Function, const std::vector<T>&>, "Function must return double and accept a vector of T.");
-		if (data1.empty() || data2.empty()) return { 0.0, 0.0 };
+		if (data.empty()) return { 0.0, 0.0 };
 		if (confidence_level <= 0 || confidence_level >= 100) throw std::out_of_range("Confidence level must be between 0 and 1.");
-		std::vector<T> result_vector;
-		for (unsigned int i = 0; i < nmax; ++i)
-		{
-			std::vector<T> resampled_data1 = resample(data1);
-			std::vector<T> resampled_data2 = resample(data2);
-			double result1 = func(resampled_data1);
-			double result2 = func(resampled_data2);
-			double result = result1 - result2;
-			result_vector.push_back(result);
-		}
+		std::vector<T> result_vector = detail::bootstrap_statistics<T, true>(nmax, func, [&](Function& f) { return f(resample(data)); });
 		double min = percentile(result_vector, (100 - confidence_level) / 2);
 		double max = percentile(result_vector, 100 - (100 - confidence_level) / 2);
 		return { min, max };
 	}
 
+	/**
+	 * @brief Calculate the confidence interval of the difference between two statistics using bootstrap resampling.
+	 * 
+	 * @tparam T The type of the elements in the vector.
+	 * @param data1 The first vector of numbers.
+	 * @param data2 The second vector of numbers.
+	 * @param func The function to apply to the resampled data.
+	 * @param confidence_level The confidence level (0-100).
+	 * @param nmax The number of bootstrap samples to generate.
+	 * @return A pair containing the lower and upper bounds of the confidence interval.
+	 */
+	template<typename T, typename Function>
+	std::pair<double, double> confidence_interval(const std::vector<T>& data1, const std::vector<T>& data2, Function func, double confidence_level, unsigned int nmax = 1024)
+	{
+		static_assert(std::is_invocable_r_v<double, Function, const std::vector<T>&>, "Function must return double and accept a vector of T.");
+		if (data1.empty() || data2.empty()) return { 0.0, 0.0 };
+		if (confidence_level <= 0 || confidence_level >= 100) throw std::out_of_range("Confidence level must be between 0 and 1.");
+		std::vector<T> result_vector = detail::bootstrap_statistics<T, false>(nmax, func,
+			[&](Function& f) { return f(resample(data1)) - f(resample(data2)); });
+		double min = percentile(result_vector, (100 - confidence_level) / 2);
+		double max = percentile(result_vector, 100 - (100 - confidence_level) / 2);
+		return { min, max };
+	}
+
+	/**
+	 * @brief Calculate the confidence interval of the difference between two statistics using bootstrap resampling in parallel.
+	 *
+	 * The resamples are spread over the default executor. Each task works on
+	 * its own copy of func, so func must be copyable and its copies must be
+	 * safe to call from different threads at once.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data1 The first vector of numbers.
+	 * @param data2 The second vector of numbers.
+	 * @param func The function to apply to the resampled data.
+	 * @param confidence_level The confidence level (0-100).
+	 * @param nmax The number of bootstrap samples to generate.
+	 * @return A pair containing the lower and upper bounds of the confidence interval.
+	 */
+	template<typename T, typename Function>
+	std::pair<double, double> confidence_interval(parallel_t, const std::vector<T>& data1, const std::vector<T>& data2, Function func, double confidence_level, unsigned int nmax = 1024)
+	{
+		static_assert(std::is_invocable_r_v<double, Function, const std::vector<T>&>, "Function must return double and accept a vector of T.");
+		if (data1.empty() || data2.empty()) return { 0.0, 0.0 };
+		if (confidence_level <= 0 || confidence_level >= 100) throw std::out_of_range("Confidence level must be between 0 and 1.");
+		std::vector<T> result_vector = detail::bootstrap_statistics<T, true>(nmax, func,
+			[&](Function& f) { return f(resample(data1)) - f(resample(data2)); });
+		double min = percentile(result_vector, (100 - confidence_level) / 2);
+		double max = percentile(result_vector, 100 - (100 - confidence_level) / 2);
+		return { min, max };
+	}
+
+	namespace detail
+	{
+		/**
+		 * @brief Add a value to a Neumaier-compensated running sum.
+		 *
+		 * @param sum The running sum.
+		 * @param compensation The running compensation term.
+		 * @param value The value to add.
+		 */
+		inline void compensated_add(double& sum, double& compensation, double value)
+		{
+			double t = sum + value;
+			if (std::abs(sum) >= std::abs(value))
+				compensation += (sum - t) + value;
+			else
+				compensation += (value - t) + sum;
+			sum = t;
+		}
+	}
+
+	/**
+	 * @brief Prebuilt index answering sum, mean, variance and range queries over
+	 * arbitrary subranges [first, last) of a series in O(1).
+	 *
+	 * Sums and sums of squares are kept as compensated prefix sums of the values
+	 * shifted by the first element, which keeps the variance free of catastrophic
+	 * cancellation for data with a large offset. Minimum and maximum use a sparse
+	 * table over fixed-size blocks plus a bounded scan of the partial blocks at
+	 * either end of the query.
+	 *
+	 * @tparam T The type of the elements in the series.
+	 */
+	template<typename T>
+	class RangeIndex
+	{
+	public:
+		RangeIndex() = default;
+
+		/**
+		 * @brief Build the index over a vector of numbers.
+		 *
+		 * @param data The vector of numbers.
+		 */
+		explicit RangeIndex(const std::vector<T>& data)
+			: data_(data)
+		{
+			build();
+		}
+
+		/**
+		 * @brief Append a value to the end of the indexed series in amortised O(log n).
+		 *
+		 * @param value The value to append.
+		 */
+		void append(T value)
+		{
+			if (data_.empty()) shift_ = static_cast<double>(value);
+			data_.push_back(value);
+			Prefix next = prefix_.back();
+			double x = static_cast<double>(value) - shift_;
+			detail::compensated_add(next.sum, next.sum_comp, x);
+			detail::compensated_add(next.sq, next.sq_comp, x * x);
+			prefix_.push_back(next);
+			if (data_.size() % block_size == 0) append_block(data_.size() / block_size - 1);
+		}
+
+		/**
+		 * @brief The number of elements in the indexed series.
+		 */
+		size_t size() const { return data_.size(); }
+
+		/**
+		 * @brief Calculate the sum of the elements in [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @return The sum of the elements in the subrange.
+		 */
+		double sum(size_t first, size_t last) const
+		{
+			check_range(first, last);
+			return shifted_sum(first, last) + shift_ * (last - first);
+		}
+
+		/**
+		 * @brief Calculate the arithmetic mean of the elements in [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @return The arithmetic mean of the subrange.
+		 */
+		double mean(size_t first, size_t last) const
+		{
+			check_range(first, last);
+			if (first == last) return 0.0;
+			return shifted_sum(first, last) / (last - first) + shift_;
+		}
+
+		/**
+		 * @brief Calculate the (population) variance of the elements in [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @return The variance of the subrange.
+		 */
+		double variance(size_t first, size_t last) const
+		{
+			check_range(first, last);
+			if (first == last) return 0.0;
+			double n = static_cast<double>(last - first);
+			double s = shifted_sum(first, last);
+			double q = (prefix_[last].sq - prefix_[first].sq) + (prefix_[last].sq_comp - prefix_[first].sq_comp);
+			return std::max(0.0, (q - s * s / n) / n);
+		}
+
+		/**
+		 * @brief Calculate the standard deviation of the elements in [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @return The standard deviation of the subrange.
+		 */
+		double stdev(size_t first, size_t last) const
+		{
+			return std::sqrt(variance(first, last));
+		}
+
+		/**
+		 * @brief Find the smallest element in [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @return The smallest element of the subrange.
+		 */
+		T min(size_t first, size_t last) const
+		{
+			check_range(first, last);
+			if (first == last) throw std::out_of_range("Range must not be empty.");
+			return extreme(first, last, min_table_, [](T a, T b) { return std::min(a, b); });
+		}
+
+		/**
+		 * @brief Find the largest element in [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @return The largest element of the subrange.
+		 */
+		T max(size_t first, size_t last) const
+		{
+			check_range(first, last);
+			if (first == last) throw std::out_of_range("Range must not be empty.");
+			return extreme(first, last, max_table_, [](T a, T b) { return std::max(a, b); });
+		}
+
+		/**
+		 * @brief Calculate the range (max - min) of the elements in [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @return The range of the subrange.
+		 */
+		double range(size_t first, size_t last) const
+		{
+			check_range(first, last);
+			if (first == last) return 0.0;
+			return static_cast<double>(max(first, last)) - static_cast<double>(min(first, last));
+		}
+
+	private:
+		static constexpr size_t block_size = 32;
+		static size_t parallel_grain() { return grain_size(ParallelAlgorithm::index_build); }
+
+		struct Prefix
+		{
+			double sum = 0.0;
+			double sum_comp = 0.0;
+			double sq = 0.0;
+			double sq_comp = 0.0;
+		};
+
+		void check_range(size_t first, size_t last) const
+		{
+			if (first > last || last > data_.size()) throw std::out_of_range("Invalid range for RangeIndex query.");
+		}
+
+		double shifted_sum(size_t first, size_t last) const
+		{
+			return (prefix_[last].sum - prefix_[first].sum) + (prefix_[last].sum_comp - prefix_[first].sum_comp);
+		}
+
+		void build()
+		{
+			size_t n = data_.size();
+			shift_ = n == 0 ? 0.0 : static_cast<double>(data_[0]);
+			prefix_.assign(n + 1, Prefix{});
+
+			// Each chunk scans its own slice, then the chunk totals are scanned
+			// serially and added back as offsets.
+			size_t chunks = std::max<size_t>(1, std::min(detail::worker_count(), n / parallel_grain()));
+			size_t step = (n + chunks - 1) / chunks;
+			detail::parallel_for(chunks, 1, [&](size_t cb, size_t ce) {
+				for (size_t c = cb; c < ce; ++c)
+				{
+					Prefix running;
+					for (size_t i = c * step; i < std::min(n, (c + 1) * step); ++i)
+					{
+						double x = static_cast<double>(data_[i]) - shift_;
+						detail::compensated_add(running.sum, running.sum_comp, x);
+						detail::compensated_add(running.sq, running.sq_comp, x * x);
+						prefix_[i + 1] = running;
+					}
+				}
+			});
+			std::vector<Prefix> offsets(chunks);
+			for (size_t c = 1; c < chunks; ++c)
+			{
+				const Prefix& total = prefix_[std::min(n, c * step)];
+				offsets[c] = offsets[c - 1];
+				detail::compensated_add(offsets[c].sum, offsets[c].sum_comp, total.sum);
+				detail::compensated_add(offsets[c].sq, offsets[c].sq_comp, total.sq);
+				offsets[c].sum_comp += total.sum_comp;
+				offsets[c].sq_comp += total.sq_comp;
+			}
+			detail::parallel_for(chunks, 1, [&](size_t cb, size_t ce) {
+				for (size_t c = std::max<size_t>(cb, 1); c < ce; ++c)
+				{
+					const Prefix& base = offsets[c];
+					for (size_t i = c * step; i < std::min(n, (c + 1) * step); ++i)
+					{
+						Prefix& p = prefix_[i + 1];
+						double sum = base.sum, sum_comp = base.sum_comp + p.sum_comp;
+						double sq = base.sq, sq_comp = base.sq_comp + p.sq_comp;
+						detail::compensated_add(sum, sum_comp, p.sum);
+						detail::compensated_add(sq, sq_comp, p.sq);
+						p = Prefix{ sum, sum_comp, sq, sq_comp };
+					}
+				}
+			});
+
+			size_t blocks = n / block_size;
+			min_table_.assign(1, std::vector<T>(blocks));
+			max_table_.assign(1, std::vector<T>(blocks));
+			detail::parallel_for(blocks, parallel_grain() / block_size, [&](size_t b, size_t e) {
+				for (size_t k = b; k < e; ++k)
+				{
+					auto [lo, hi] = std::minmax_element(data_.begin() + k * block_size, data_.begin() + (k + 1) * block_size);
+					min_table_[0][k] = *lo;
+					max_table_[0][k] = *hi;
+				}
+			});
+			for (size_t level = 1; (size_t(1) << level) <= blocks; ++level)
+			{
+				size_t width = size_t(1) << level;
+				min_table_.emplace_back(blocks - width + 1);
+				max_table_.emplace_back(blocks - width + 1);
+				detail::parallel_for(blocks - width + 1, parallel_grain(), [&, level, width](size_t b, size_t e) {
+					for (size_t k = b; k < e; ++k)
+					{
+						min_table_[level][k] = std::min(min_table_[level - 1][k], min_table_[level - 1][k + width / 2]);
+						max_table_[level][k] = std::max(max_table_[level - 1][k], max_table_[level - 1][k + width / 2]);
+					}
+				});
+			}
+		}
+
+		void append_block(size_t block)
+		{
+			auto [lo, hi] = std::minmax_element(data_.begin() + block * block_size, data_.begin() + (block + 1) * block_size);
+			if (min_table_.empty())
+			{
+				min_table_.emplace_back();
+				max_table_.emplace_back();
+			}
+			min_table_[0].push_back(*lo);
+			max_table_[0].push_back(*hi);
+			size_t blocks = block + 1;
+			for (size_t level = 1; (size_t(1) << level) <= blocks; ++level)
+			{
+				size_t width = size_t(1) << level;
+				if (min_table_.size() == level)
+				{
+					min_table_.emplace_back();
+					max_table_.emplace_back();
+				}
+				size_t k = blocks - width;
+				min_table_[level].push_back(std::min(min_table_[level - 1][k], min_table_[level - 1][k + width / 2]));
+				max_table_[level].push_back(std::max(max_table_[level - 1][k], max_table_[level - 1][k + width / 2]));
+			}
+		}
+
+		template<typename Combine>
+		T extreme(size_t first, size_t last, const std::vector<std::vector<T>>& table, Combine combine) const
+		{
+			size_t first_block = (first + block_size - 1) / block_size;
+			size_t last_block = last / block_size;
+			if (first_block >= last_block)
+			{
+				T result = data_[first];
+				for (size_t i = first + 1; i < last; ++i) result = combine(result, data_[i]);
+				return result;
+			}
+			size_t count = last_block - first_block;
+			size_t level = 0;
+			while ((size_t(2) << level) <= count) ++level;
+			T result = combine(table[level][first_block], table[level][last_block - (size_t(1) << level)]);
+			for (size_t i = first; i < first_block * block_size; ++i) result = combine(result, data_[i]);
+			for (size_t i = last_block * block_size; i < last; ++i) result = combine(result, data_[i]);
+			return result;
+		}
+
+		std::vector<T> data_;
+		std::vector<Prefix> prefix_ = std::vector<Prefix>(1);
+		std::vector<std::vector<T>> min_table_;
+		std::vector<std::vector<T>> max_table_;
+		double shift_ = 0.0;
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief Count the set bits of a 64-bit word.
+		 */
+		inline unsigned int popcount64(uint64_t x)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return static_cast<unsigned int>(__builtin_popcountll(x));
+#else
+			x = x - ((x >> 1) & 0x5555555555555555ULL);
+			x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+			x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+			return static_cast<unsigned int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+		}
+
+		/**
+		 * @brief Static bit vector with constant-time rank.
+		 *
+		 * Bits are stored in 64-byte blocks holding the cumulative rank followed by
+		 * 448 payload bits, so a rank query touches a single cache line.
+		 */
+		class RankBitVector
+		{
+		public:
+			static constexpr size_t words_per_block = 7;
+			static constexpr size_t bits_per_block = words_per_block * 64;
+
+			RankBitVector() = default;
+
+			explicit RankBitVector(size_t n)
+				: size_(n), blocks_(n / bits_per_block + 1)
+			{
+			}
+
+			size_t size() const { return size_; }
+
+			/**
+			 * @brief Set bit i. Not thread safe for bits sharing a 64-bit word.
+			 */
+			void set(size_t i)
+			{
+				blocks_[i / bits_per_block].words[(i % bits_per_block) / 64] |= uint64_t(1) << (i % 64);
+			}
+
+			bool get(size_t i) const
+			{
+				return (blocks_[i / bits_per_block].words[(i % bits_per_block) / 64] >> (i % 64)) & 1;
+			}
+
+			/**
+			 * @brief Fill in the cumulative ranks once all bits are set.
+			 */
+			void build_rank()
+			{
+				uint64_t total = 0;
+				for (Block& block : blocks_)
+				{
+					block.rank = total;
+					for (uint64_t word : block.words) total += popcount64(word);
+				}
+			}
+
+			/**
+			 * @brief The number of set bits in [0, i).
+			 */
+			size_t rank1(size_t i) const
+			{
+				const Block& block = blocks_[i / bits_per_block];
+				size_t offset = i % bits_per_block;
+				size_t result = static_cast<size_t>(block.rank);
+				for (size_t w = 0; w < offset / 64; ++w) result += popcount64(block.words[w]);
+				if (offset % 64 != 0) result += popcount64(block.words[offset / 64] & ((uint64_t(1) << (offset % 64)) - 1));
+				return result;
+			}
+
+			/**
+			 * @brief The number of clear bits in [0, i).
+			 */
+			size_t rank0(size_t i) const { return i - rank1(i); }
+
+		private:
+			struct alignas(64) Block
+			{
+				uint64_t rank = 0;
+				uint64_t words[words_per_block] = {};
+			};
+
+			size_t size_ = 0;
+			std::vector<Block> blocks_;
+		};
+	}
+
+	/**
+	 * @brief Static wavelet matrix answering k-th smallest and percentile queries
+	 * over arbitrary subranges [first, last) of a series in O(log sigma), where
+	 * sigma is the number of distinct values.
+	 *
+	 * Values are rank-reduced to dense codes, so memory is about
+	 * n * ceil(log2(sigma)) bits plus the distinct values themselves.
+	 *
+	 * @tparam T The type of the elements in the series.
+	 */
+	template<typename T>
+	class WaveletMatrix
+	{
+	public:
+		WaveletMatrix() = default;
+
+		/**
+		 * @brief Build the wavelet matrix over a vector of numbers.
+		 *
+		 * @param data The vector of numbers.
+		 */
+		explicit WaveletMatrix(const std::vector<T>& data)
+			: size_(data.size())
+		{
+			values_ = data;
+			detail::parallel_sort(values_.begin(), values_.end());
+			values_.erase(std::unique(values_.begin(), values_.end()), values_.end());
+			while ((size_t(1) << levels_) < values_.size()) ++levels_;
+			levels_ = std::max<size_t>(levels_, 1);
+
+			std::vector<uint32_t> codes(size_), next(size_);
+			detail::parallel_for(size_, parallel_grain(), [&](size_t b, size_t e) {
+				for (size_t i = b; i < e; ++i)
+					codes[i] = static_cast<uint32_t>(std::lower_bound(values_.begin(), values_.end(), data[i]) - values_.begin());
+			});
+
+			bits_.reserve(levels_);
+			zeros_.reserve(levels_);
+			for (size_t level = 0; level < levels_; ++level)
+			{
+				size_t shift = levels_ - 1 - level;
+				detail::RankBitVector bits(size_);
+				// Chunks cover whole 64-bit words so threads never share one.
+				size_t words = (size_ + 63) / 64;
+				size_t chunks = std::min(detail::worker_count(), std::max<size_t>(1, size_ / parallel_grain()));
+				size_t step = (words + chunks - 1) / chunks * 64;
+				std::vector<size_t> chunk_zeros(chunks, 0);
+				detail::parallel_for(chunks, 1, [&](size_t cb, size_t ce) {
+					for (size_t c = cb; c < ce; ++c)
+					{
+						for (size_t i = c * step; i < std::min(size_, (c + 1) * step); ++i)
+						{
+							if ((codes[i] >> shift) & 1) bits.set(i);
+							else ++chunk_zeros[c];
+						}
+					}
+				});
+				bits.build_rank();
+				size_t zeros = std::accumulate(chunk_zeros.begin(), chunk_zeros.end(), size_t(0));
+
+				// Stable partition: zeros keep their order at the front, ones after them.
+				std::vector<size_t> zero_offset(chunks, 0), one_offset(chunks, zeros);
+				for (size_t c = 1; c < chunks; ++c)
+				{
+					size_t chunk_size = std::min(size_, c * step) - std::min(size_, (c - 1) * step);
+					zero_offset[c] = zero_offset[c - 1] + chunk_zeros[c - 1];
+					one_offset[c] = one_offset[c - 1] + (chunk_size - chunk_zeros[c - 1]);
+				}
+				detail::parallel_for(chunks, 1, [&](size_t cb, size_t ce) {
+					for (size_t c = cb; c < ce; ++c)
+					{
+						size_t z = zero_offset[c], o = one_offset[c];
+						for (size_t i = c * step; i < std::min(size_, (c + 1) * step); ++i)
+						{
+							if ((codes[i] >> shift) & 1) next[o++] = codes[i];
+							else next[z++] = codes[i];
+						}
+					}
+				});
+				codes.swap(next);
+				bits_.push_back(std::move(bits));
+				zeros_.push_back(zeros);
+			}
+		}
+
+		/**
+		 * @brief The number of elements in the indexed series.
+		 */
+		size_t size() const { return size_; }
+
+		/**
+		 * @brief Find the k-th smallest element (0-based) in [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @param k The 0-based rank within the subrange.
+		 * @return The k-th smallest element of the subrange.
+		 */
+		T kth_smallest(size_t first, size_t last, size_t k) const
+		{
+			if (first > last || last > size_) throw std::out_of_range("Invalid range for WaveletMatrix query.");
+			if (k >= last - first) throw std::out_of_range("Rank must be smaller than the range length.");
+			size_t code = 0;
+			for (size_t level = 0; level < levels_; ++level)
+			{
+				const detail::RankBitVector& bits = bits_[level];
+				size_t zeros_before = bits.rank0(first);
+				size_t zeros_in_range = bits.rank0(last) - zeros_before;
+				code <<= 1;
+				if (k < zeros_in_range)
+				{
+					first = zeros_before;
+					last = zeros_before + zeros_in_range;
+				}
+				else
+				{
+					k -= zeros_in_range;
+					code |= 1;
+					first = zeros_[level] + (first - zeros_before);
+					last = zeros_[level] + bits.rank1(last);
+				}
+			}
+			return values_[code];
+		}
+
+		/**
+		 * @brief Calculate the percentile of [first, last) using the same linear
+		 * interpolation as BasicStats::percentile.
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @param p The percentile to calculate (0-100).
+		 * @return The value at the specified percentile of the subrange.
+		 */
+		double percentile(size_t first, size_t last, double p) const
+		{
+			if (first > last || last > size_) throw std::out_of_range("Invalid range for WaveletMatrix query.");
+			if (first == last) return 0.0;
+			if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+			double rank = (p / 100) * (last - first - 1);
+			size_t lower = static_cast<size_t>(std::floor(rank));
+			size_t upper = static_cast<size_t>(std::ceil(rank));
+			double weight = rank - lower;
+			double low_value = static_cast<double>(kth_smallest(first, last, lower));
+			if (upper == lower) return low_value;
+			return low_value + weight * (static_cast<double>(kth_smallest(first, last, upper)) - low_value);
+		}
+
+		/**
+		 * @brief Calculate the median of [first, last).
+		 *
+		 * @param first The index of the first element.
+		 * @param last One past the index of the last element.
+		 * @return The median of the subrange.
+		 */
+		double median(size_t first, size_t last) const
+		{
+			return percentile(first, last, 50);
+		}
+
+	private:
+		static size_t parallel_grain() { return grain_size(ParallelAlgorithm::index_build); }
+
+		size_t size_ = 0;
+		size_t levels_ = 0;
+		std::vector<T> values_;
+		std::vector<detail::RankBitVector> bits_;
+		std::vector<size_t> zeros_;
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief Count the trailing zero bits of a non-zero 64-bit word.
+		 */
+		inline unsigned int ctz64(uint64_t x)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return static_cast<unsigned int>(__builtin_ctzll(x));
+#else
+			unsigned int n = 0;
+			while ((x & 1) == 0)
+			{
+				x >>= 1;
+				++n;
+			}
+			return n;
+#endif
+		}
+
+		/**
+		 * @brief Hint the processor to fetch the cache line holding an address.
+		 */
+		inline void prefetch(const void* address)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			__builtin_prefetch(address);
+#else
+			(void)address;
+#endif
+		}
+	}
+
+	/**
+	 * @brief Empirical cumulative distribution function of a reference sample.
+	 *
+	 * The sorted keys are stored in Eytzinger (breadth-first) order, padded to a
+	 * full tree, so every lookup runs a fixed number of branch-free steps whose
+	 * next cache lines are prefetched ahead of time. Batch lookups advance a group
+	 * of queries in lockstep so their memory accesses overlap.
+	 *
+	 * @tparam T The type of the elements in the sample.
+	 */
+	template<typename T>
+	class ECDF
+	{
+	public:
+		ECDF() = default;
+
+		/**
+		 * @brief Build the ECDF of a vector of numbers.
+		 *
+		 * @param data The vector of numbers.
+		 */
+		explicit ECDF(const std::vector<T>& data)
+			: sorted_(data)
+		{
+			std::sort(sorted_.begin(), sorted_.end());
+			size_t n = sorted_.size();
+			while ((size_t(1) << depth_) <= n) ++depth_;
+			keys_.assign(size_t(1) << depth_, T{});
+			ranks_.assign(size_t(1) << depth_, n);
+			size_t next = 0;
+			fill(1, next);
+		}
+
+		/**
+		 * @brief The number of elements in the reference sample.
+		 */
+		size_t size() const { return sorted_.size(); }
+
+		/**
+		 * @brief Fraction of the reference sample less than or equal to x.
+		 *
+		 * @param x The value to look up.
+		 * @return The empirical CDF at x, in [0, 1].
+		 */
+		double cdf(T x) const
+		{
+			if (sorted_.empty()) return 0.0;
+			size_t k = 1;
+			for (size_t level = 0; level < depth_; ++level)
+			{
+				detail::prefetch(keys_.data() + std::min(k * prefetch_stride, keys_.size() - 1));
+				k = 2 * k + static_cast<size_t>((k > sorted_.size()) | (keys_[k] <= x));
+			}
+			return static_cast<double>(count_at(k)) / size();
+		}
+
+		/**
+		 * @brief Evaluate the empirical CDF at a batch of values.
+		 *
+		 * @param xs The values to look up.
+		 * @return The empirical CDF at each value, in [0, 1].
+		 */
+		std::vector<double> cdf(const std::vector<T>& xs) const
+		{
+			std::vector<double> result(xs.size(), 0.0);
+			if (sorted_.empty()) return result;
+			size_t n = size();
+			size_t k[batch_size];
+			for (size_t base = 0; base < xs.size(); base += batch_size)
+			{
+				size_t count = std::min(batch_size, xs.size() - base);
+				for (size_t j = 0; j < count; ++j) k[j] = 1;
+				for (size_t level = 0; level < depth_; ++level)
+				{
+					for (size_t j = 0; j < count; ++j)
+					{
+						detail::prefetch(keys_.data() + std::min(k[j] * prefetch_stride, keys_.size() - 1));
+						k[j] = 2 * k[j] + static_cast<size_t>((k[j] > n) | (keys_[k[j]] <= xs[base + j]));
+					}
+				}
+				for (size_t j = 0; j < count; ++j) result[base + j] = static_cast<double>(count_at(k[j])) / n;
+			}
+			return result;
+		}
+
+		/**
+		 * @brief Find the value at quantile q using the same linear interpolation
+		 * as BasicStats::percentile(data, 100 * q).
+		 *
+		 * @param q The quantile to calculate (0-1).
+		 * @return The value at the specified quantile.
+		 */
+		double quantile(double q) const
+		{
+			if (sorted_.empty()) return 0.0;
+			if (q < 0 || q > 1) throw std::out_of_range("Quantile must be between 0 and 1.");
+			double rank = q * (sorted_.size() - 1);
+			size_t lower = static_cast<size_t>(std::floor(rank));
+			size_t upper = static_cast<size_t>(std::ceil(rank));
+			double weight = rank - lower;
+			return sorted_[lower] + weight * (static_cast<double>(sorted_[upper]) - sorted_[lower]);
+		}
+
+		/**
+		 * @brief Find the values at a batch of quantiles.
+		 *
+		 * @param qs The quantiles to calculate (0-1).
+		 * @return The value at each quantile.
+		 */
+		std::vector<double> quantile(const std::vector<double>& qs) const
+		{
+			std::vector<double> result(qs.size(), 0.0);
+			if (sorted_.empty()) return result;
+			if (std::any_of(qs.begin(), qs.end(), [](double q) { return !(q >= 0 && q <= 1); }))
+				throw std::out_of_range("Quantile must be between 0 and 1.");
+			double last = static_cast<double>(sorted_.size() - 1);
+			for (size_t i = 0; i < qs.size(); ++i)
+			{
+				double rank = qs[i] * last;
+				size_t lower = static_cast<size_t>(rank);
+				size_t upper = std::min(lower + 1, sorted_.size() - 1);
+				double weight = rank - lower;
+				result[i] = sorted_[lower] + weight * (static_cast<double>(sorted_[upper]) - sorted_[lower]);
+			}
+			return result;
+		}
+
+	private:
+		static constexpr size_t batch_size = 16;
+		static constexpr size_t prefetch_stride = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+
+		// In-order traversal of the implicit tree assigns sorted keys to nodes.
+		void fill(size_t k, size_t& next)
+		{
+			if (k > sorted_.size()) return;
+			fill(2 * k, next);
+			keys_[k] = sorted_[next];
+			ranks_[k] = next++;
+			fill(2 * k + 1, next);
+		}
+
+		// Strip the trailing right turns and the final left turn to recover the
+		// node holding the first key greater than the query.
+		size_t count_at(size_t k) const
+		{
+			k >>= detail::ctz64(~static_cast<uint64_t>(k)) + 1;
+			return k == 0 ? size() : ranks_[k];
+		}
+
+		std::vector<T> sorted_;
+		std::vector<T> keys_;
+		std::vector<size_t> ranks_;
+		size_t depth_ = 0;
+	};
+
+	/**
+	 * @brief Mergeable accumulator of count, mean, second central moment, minimum and maximum.
+	 *
+	 * Values are added with Welford's update and partial accumulators are combined
+	 * with Chan's pairwise formula, so the result does not depend on how the data
+	 * was split. The variance is the population variance, like BasicStats::variance.
+	 */
+	class Moments
+	{
+	public:
+		Moments() = default;
+
+		/**
+		 * @brief Rebuild an accumulator from its raw state.
+		 *
+		 * @param count The number of values.
+		 * @param mean The mean of the values.
+		 * @param m2 The sum of squared deviations from the mean.
+		 * @param min The smallest value.
+		 * @param max The largest value.
+		 */
+		Moments(size_t count, double mean, double m2, double min, double max)
+			: count_(count), mean_(mean), m2_(m2), min_(min), max_(max)
+		{
+			if (count_ == 0) *this = Moments();
+		}
+
+		/**
+		 * @brief Add a single value.
+		 *
+		 * @param value The value to add.
+		 */
+		void push(double value)
+		{
+			++count_;
+			double delta = value - mean_;
+			mean_ += delta / count_;
+			m2_ += delta * (value - mean_);
+			min_ = std::min(min_, value);
+			max_ = std::max(max_, value);
+		}
+
+		/**
+		 * @brief Add a contiguous batch of values.
+		 *
+		 * The batch is reduced in cache-sized blocks with a two-pass mean and sum of
+		 * squared deviations, which vectorise, and each block is merged in.
+		 *
+		 * @tparam T The type of the values.
+		 * @param data Pointer to the first value.
+		 * @param n The number of values.
+		 */
+		template<typename T>
+		void push(const T* data, size_t n)
+		{
+			constexpr size_t block = 1024;
+			for (size_t begin = 0; begin < n; begin += block)
+			{
+				size_t len = std::min(block, n - begin);
+				const T* p = data + begin;
+				double s = 0.0;
+				double lo = static_cast<double>(p[0]), hi = lo;
+				for (size_t i = 0; i < len; ++i)
+				{
+					double x = static_cast<double>(p[i]);
+					s += x;
+					lo = std::min(lo, x);
+					hi = std::max(hi, x);
+				}
+				double m = s / len;
+				double m2 = 0.0;
+				for (size_t i = 0; i < len; ++i)
+				{
+					double d = static_cast<double>(p[i]) - m;
+					m2 += d * d;
+				}
+				merge(Moments(len, m, m2, lo, hi));
+			}
+		}
+
+		/**
+		 * @brief Add every value of a vector.
+		 *
+		 * @tparam T The type of the elements in the vector.
+		 * @param data The vector of numbers.
+		 */
+		template<typename T>
+		void push(const std::vector<T>& data)
+		{
+			push(data.data(), data.size());
+		}
+
+		/**
+		 * @brief Combine another accumulator into this one.
+		 *
+		 * @param other The accumulator to merge.
+		 */
+		void merge(const Moments& other)
+		{
+			if (other.count_ == 0) return;
+			if (count_ == 0)
+			{
+				*this = other;
+				return;
+			}
+			size_t n = count_ + other.count_;
+			double delta = other.mean_ - mean_;
+			mean_ += delta * other.count_ / n;
+			m2_ += other.m2_ + delta * delta * (static_cast<double>(count_) * other.count_ / n);
+			count_ = n;
+			min_ = std::min(min_, other.min_);
+			max_ = std::max(max_, other.max_);
+		}
+
+		/**
+		 * @brief Reset to the empty state.
+		 */
+		void clear() { *this = Moments(); }
+
+		size_t count() const { return count_; }
+		double sum() const { return mean_ * count_; }
+		double mean() const { return mean_; }
+		double m2() const { return m2_; }
+		double variance() const { return count_ == 0 ? 0.0 : m2_ / count_; }
+		double stdev() const { return std::sqrt(variance()); }
+		double min() const { return count_ == 0 ? 0.0 : min_; }
+		double max() const { return count_ == 0 ? 0.0 : max_; }
+		double range() const { return max() - min(); }
+
+	private:
+		size_t count_ = 0;
+		double mean_ = 0.0;
+		double m2_ = 0.0;
+		double min_ = std::numeric_limits<double>::infinity();
+		double max_ = -std::numeric_limits<double>::infinity();
+	};
+
+	/**
+	 * @brief Sample set that caches its moments and sort order across queries.
+	 *
+	 * Appends update the moments immediately in O(1) and are collected in a
+	 * pending run. The next order-statistic query sorts only the pending run and
+	 * merges it into the cached sorted data, so repeated queries are O(1) and
+	 * appends never force a full re-sort. Queries mutate the cache and are
+	 * therefore not safe to call concurrently.
+	 *
+	 * @tparam T The type of the elements in the data set.
+	 */
+	template<typename T>
+	class Dataset
+	{
+	public:
+		Dataset() = default;
+
+		/**
+		 * @brief Build a data set from a vector of numbers.
+		 *
+		 * @param data The vector of numbers.
+		 */
+		explicit Dataset(std::vector<T> data)
+			: data_(std::move(data))
+		{
+			moments_.push(data_);
+		}
+
+		/**
+		 * @brief Append a single value.
+		 *
+		 * @param value The value to append.
+		 */
+		void append(T value)
+		{
+			data_.push_back(value);
+			moments_.push(static_cast<double>(value));
+		}
+
+		/**
+		 * @brief Append every value of a vector.
+		 *
+		 * @param values The vector of numbers.
+		 */
+		void append(const std::vector<T>& values)
+		{
+			data_.insert(data_.end(), values.begin(), values.end());
+			moments_.push(values);
+		}
+
+		size_t size() const { return data_.size(); }
+		bool empty() const { return data_.empty(); }
+
+		/**
+		 * @brief The values in insertion order.
+		 */
+		const std::vector<T>& data() const { return data_; }
+
+		/**
+		 * @brief The values in ascending order, merging any pending appends first.
+		 */
+		const std::vector<T>& sorted() const
+		{
+			if (sorted_.size() < data_.size())
+			{
+				size_t mid = sorted_.size();
+				sorted_.insert(sorted_.end(), data_.begin() + mid, data_.end());
+				detail::adaptive_sort(sorted_.begin() + mid, sorted_.end());
+				std::inplace_merge(sorted_.begin(), sorted_.begin() + mid, sorted_.end());
+			}
+			return sorted_;
+		}
+
+		/**
+		 * @brief The cached moment accumulator of the data set.
+		 */
+		const Moments& moments() const { return moments_; }
+
+		double sum() const { return moments_.sum(); }
+		double mean() const { return moments_.mean(); }
+		double variance() const { return moments_.variance(); }
+		double stdev() const { return moments_.stdev(); }
+		double range() const { return moments_.range(); }
+		double min() const { return moments_.min(); }
+		double max() const { return moments_.max(); }
+
+		double coeff_of_variation() const
+		{
+			if (empty()) return 0.0;
+			return stdev() / mean();
+		}
+
+		double median() const { return detail::sorted_median(sorted().begin(), sorted().end()); }
+		double first_quartile() const { return detail::sorted_first_quartile(sorted().begin(), sorted().end()); }
+		double third_quartile() const { return detail::sorted_third_quartile(sorted().begin(), sorted().end()); }
+		double iqr() const { return third_quartile() - first_quartile(); }
+
+		/**
+		 * @brief Calculate a percentile of the data set using linear interpolation.
+		 *
+		 * @param p The percentile to calculate (0-100).
+		 * @return The value at the specified percentile.
+		 */
+		double percentile(double p) const { return detail::sorted_percentile(sorted().begin(), sorted().end(), p); }
+
+	private:
+		std::vector<T> data_;
+		mutable std::vector<T> sorted_;
+		Moments moments_;
+	};
+
+	/**
+	 * @brief Dynamic multiset supporting insert, erase, rank and select in O(log n).
+	 *
+	 * Implemented as a counted B+-tree: leaves hold sorted runs of values, and
+	 * inner nodes hold the smallest value and the element count of each child, so
+	 * rank and select descend by summing counts within one small contiguous node
+	 * per level.
+	 *
+	 * @tparam T The type of the elements in the set.
+	 */
+	template<typename T>
+	class OrderStatisticTree
+	{
+	public:
+		OrderStatisticTree()
+			: root_(std::make_unique<Node>())
+		{
+		}
+
+		OrderStatisticTree(OrderStatisticTree&&) noexcept = default;
+		OrderStatisticTree& operator=(OrderStatisticTree&&) noexcept = default;
+
+		/**
+		 * @brief Build a tree holding every value of a vector.
+		 *
+		 * @param data The vector of numbers.
+		 */
+		explicit OrderStatisticTree(const std::vector<T>& data)
+			: OrderStatisticTree()
+		{
+			for (const T& value : data) insert(value);
+		}
+
+		size_t size() const { return root_->size; }
+		bool empty() const { return root_->size == 0; }
+
+		/**
+		 * @brief Remove every element.
+		 */
+		void clear() { root_ = std::make_unique<Node>(); }
+
+		/**
+		 * @brief Insert a value; duplicates are kept.
+		 *
+		 * @param value The value to insert.
+		 */
+		void insert(T value)
+		{
+			std::unique_ptr<Node> sibling = insert(*root_, value);
+			if (sibling)
+			{
+				auto root = std::make_unique<Node>();
+				root->leaf = false;
+				root->size = root_->size + sibling->size;
+				root->keys = { min_of(*root_), min_of(*sibling) };
+				root->counts = { root_->size, sibling->size };
+				root->children.push_back(std::move(root_));
+				root->children.push_back(std::move(sibling));
+				root_ = std::move(root);
+			}
+		}
+
+		/**
+		 * @brief Remove one occurrence of a value.
+		 *
+		 * @param value The value to remove.
+		 * @return True if the value was present.
+		 */
+		bool erase(T value)
+		{
+			if (!erase(*root_, value)) return false;
+			while (!root_->leaf && root_->children.size() == 1)
+			{
+				std::unique_ptr<Node> child = std::move(root_->children[0]);
+				root_ = std::move(child);
+			}
+			return true;
+		}
+
+		/**
+		 * @brief Count the elements strictly smaller than a value.
+		 *
+		 * @param value The value to rank.
+		 * @return The number of elements less than value.
+		 */
+		size_t rank(T value) const
+		{
+			size_t result = 0;
+			const Node* node = root_.get();
+			while (!node->leaf)
+			{
+				size_t i = static_cast<size_t>(std::lower_bound(node->keys.begin(), node->keys.end(), value) - node->keys.begin());
+				if (i == 0) return result;
+				for (size_t c = 0; c + 1 < i; ++c) result += node->counts[c];
+				node = node->children[i - 1].get();
+			}
+			return result + static_cast<size_t>(std::lower_bound(node->keys.begin(), node->keys.end(), value) - node->keys.begin());
+		}
+
+		/**
+		 * @brief Find the k-th smallest element (0-based).
+		 *
+		 * @param k The 0-based rank.
+		 * @return The k-th smallest element.
+		 */
+		T select(size_t k) const
+		{
+			if (k >= size()) throw std::out_of_range("Rank must be smaller than the number of elements.");
+			const Node* node = root_.get();
+			while (!node->leaf)
+			{
+				size_t c = 0;
+				while (k >= node->counts[c]) k -= node->counts[c++];
+				node = node->children[c].get();
+			}
+			return node->keys[k];
+		}
+
+		/**
+		 * @brief Calculate a percentile using the same linear interpolation as BasicStats::percentile.
+		 *
+		 * @param p The percentile to calculate (0-100).
+		 * @return The value at the specified percentile.
+		 */
+		double percentile(double p) const
+		{
+			if (empty()) return 0.0;
+			if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+			double rank = (p / 100) * (size() - 1);
+			size_t lower = static_cast<size_t>(std::floor(rank));
+			size_t upper = static_cast<size_t>(std::ceil(rank));
+			double weight = rank - lower;
+			double low_value = static_cast<double>(select(lower));
+			if (upper == lower) return low_value;
+			return low_value + weight * (static_cast<double>(select(upper)) - low_value);
+		}
+
+		/**
+		 * @brief Calculate the median of the elements.
+		 */
+		double median() const { return percentile(50); }
+
+	private:
+		static constexpr size_t leaf_capacity = 128;
+		static constexpr size_t inner_capacity = 32;
+
+		// Leaves keep their sorted values in keys; inner nodes keep the smallest
+		// value of each child in keys alongside its element count.
+		struct Node
+		{
+			bool leaf = true;
+			size_t size = 0;
+			std::vector<T> keys;
+			std::vector<size_t> counts;
+			std::vector<std::unique_ptr<Node>> children;
+		};
+
+		static const T& min_of(const Node& node) { return node.keys.front(); }
+
+		static size_t capacity_of(const Node& node) { return node.leaf ? leaf_capacity : inner_capacity; }
+
+		// The last child whose smallest value is not greater than value.
+		static size_t route(const Node& node, const T& value)
+		{
+			size_t i = static_cast<size_t>(std::upper_bound(node.keys.begin(), node.keys.end(), value) - node.keys.begin());
+			return i == 0 ? 0 : i - 1;
+		}
+
+		static std::unique_ptr<Node> split(Node& node)
+		{
+			auto sibling = std::make_unique<Node>();
+			sibling->leaf = node.leaf;
+			size_t half = node.keys.size() / 2;
+			sibling->keys.assign(node.keys.begin() + half, node.keys.end());
+			node.keys.resize(half);
+			if (node.leaf)
+			{
+				sibling->size = sibling->keys.size();
+			}
+			else
+			{
+				sibling->counts.assign(node.counts.begin() + half, node.counts.end());
+				node.counts.resize(half);
+				for (size_t c = half; c < node.children.size(); ++c) sibling->children.push_back(std::move(node.children[c]));
+				node.children.resize(half);
+				sibling->size = std::accumulate(sibling->counts.begin(), sibling->counts.end(), size_t(0));
+			}
+			node.size -= sibling->size;
+			return sibling;
+		}
+
+		static std::unique_ptr<Node> insert(Node& node, const T& value)
+		{
+			++node.size;
+			if (node.leaf)
+			{
+				node.keys.insert(std::upper_bound(node.keys.begin(), node.keys.end(), value), value);
+				return node.keys.size() > leaf_capacity ? split(node) : nullptr;
+			}
+			size_t i = route(node, value);
+			std::unique_ptr<Node> sibling = insert(*node.children[i], value);
+			node.keys[i] = min_of(*node.children[i]);
+			node.counts[i] = node.children[i]->size;
+			if (sibling)
+			{
+				node.keys.insert(node.keys.begin() + i + 1, min_of(*sibling));
+				node.counts.insert(node.counts.begin() + i + 1, sibling->size);
+				node.children.insert(node.children.begin() + i + 1, std::move(sibling));
+			}
+			return node.children.size() > inner_capacity ? split(node) : nullptr;
+		}
+
+		static bool erase(Node& node, const T& value)
+		{
+			if (node.leaf)
+			{
+				auto it = std::lower_bound(node.keys.begin(), node.keys.end(), value);
+				if (it == node.keys.end() || value < *it) return false;
+				node.keys.erase(it);
+				--node.size;
+				return true;
+			}
+			if (value < node.keys.front()) return false;
+			size_t i = route(node, value);
+			if (!erase(*node.children[i], value)) return false;
+			--node.size;
+			if (node.children[i]->size == 0)
+			{
+				node.keys.erase(node.keys.begin() + i);
+				node.counts.erase(node.counts.begin() + i);
+				node.children.erase(node.children.begin() + i);
+				return true;
+			}
+			node.keys[i] = min_of(*node.children[i]);
+			node.counts[i] = node.children[i]->size;
+			rebalance(node, i);
+			return true;
+		}
+
+		// Merge an underfull child into a neighbour when the result fits in one node.
+		static void rebalance(Node& node, size_t i)
+		{
+			Node& child = *node.children[i];
+			size_t capacity = capacity_of(child);
+			if (child.keys.size() >= capacity / 4) return;
+			size_t left = i;
+			if (i + 1 < node.children.size() && child.keys.size() + node.children[i + 1]->keys.size() <= capacity)
+				left = i;
+			else if (i > 0 && child.keys.size() + node.children[i - 1]->keys.size() <= capacity)
+				left = i - 1;
+			else
+				return;
+			Node& target = *node.children[left];
+			Node& source = *node.children[left + 1];
+			target.keys.insert(target.keys.end(), source.keys.begin(), source.keys.end());
+			if (!target.leaf)
+			{
+				target.counts.insert(target.counts.end(), source.counts.begin(), source.counts.end());
+				for (std::unique_ptr<Node>& grandchild : source.children) target.children.push_back(std::move(grandchild));
+			}
+			target.size += source.size;
+			node.counts[left] = target.size;
+			node.keys.erase(node.keys.begin() + left + 1);
+			node.counts.erase(node.counts.begin() + left + 1);
+			node.children.erase(node.children.begin() + left + 1);
+		}
+
+		std::unique_ptr<Node> root_;
+	};
+
+	/**
+	 * @brief Non-owning view of a contiguous sequence of elements.
+	 *
+	 * @tparam T The element type; use a const type for read-only views.
+	 */
+	template<typename T>
+	class span
+	{
+	public:
+		using element_type = T;
+		using value_type = std::remove_cv_t<T>;
+		using iterator = T*;
+
+		constexpr span() noexcept = default;
+
+		constexpr span(T* data, size_t size) noexcept
+			: data_(data), size_(size)
+		{
+		}
+
+		span(std::vector<value_type>& data) noexcept
+			: data_(data.data()), size_(data.size())
+		{
+		}
+
+		template<typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+		span(const std::vector<value_type>& data) noexcept
+			: data_(data.data()), size_(data.size())
+		{
+		}
+
+		template<typename U, typename = std::enable_if_t<std::is_convertible_v<U(*)[], T(*)[]>>>
+		constexpr span(const span<U>& other) noexcept
+			: data_(other.data()), size_(other.size())
+		{
+		}
+
+		constexpr T* data() const noexcept { return data_; }
+		constexpr size_t size() const noexcept { return size_; }
+		constexpr bool empty() const noexcept { return size_ == 0; }
+		constexpr T* begin() const noexcept { return data_; }
+		constexpr T* end() const noexcept { return data_ + size_; }
+		constexpr T& operator[](size_t i) const noexcept { return data_[i]; }
+
+		constexpr span subspan(size_t offset, size_t count) const noexcept { return span(data_ + offset, count); }
+
+	private:
+		T* data_ = nullptr;
+		size_t size_ = 0;
+	};
+
+	/**
+	 * @brief Find the k-th smallest element (0-based) across several sorted shards
+	 * without concatenating them.
+	 *
+	 * Each step picks the median of the shard midpoints weighted by their active
+	 * lengths as a pivot and locates it in every shard by binary search, which
+	 * discards at least a quarter of the remaining candidates. The cost is
+	 * O(k log n) per step over O(log N) steps for k shards and N elements.
+	 *
+	 * @tparam T The type of the elements in the shards.
+	 * @param shards The shards, each sorted in ascending order.
+	 * @param k The 0-based rank across all shards.
+	 * @return The k-th smallest element of the union of the shards.
+	 */
+	template<typename T>
+	T merged_kth_smallest(const std::vector<span<const T>>& shards, size_t k)
+	{
+		constexpr size_t small_enough = 64;
+		size_t shard_count = shards.size();
+		std::vector<size_t> lo(shard_count, 0), hi(shard_count);
+		size_t total = 0;
+		for (size_t s = 0; s < shard_count; ++s)
+		{
+			hi[s] = shards[s].size();
+			total += hi[s];
+		}
+		if (k >= total) throw std::out_of_range("Rank must be smaller than the number of elements.");
+
+		std::vector<std::pair<T, size_t>> middles;
+		std::vector<size_t> below(shard_count), through(shard_count);
+		while (true)
+		{
+			size_t active = 0;
+			middles.clear();
+			for (size_t s = 0; s < shard_count; ++s)
+			{
+				size_t width = hi[s] - lo[s];
+				if (width == 0) continue;
+				active += width;
+				middles.emplace_back(shards[s][lo[s] + width / 2], width);
+			}
+			if (active <= small_enough)
+			{
+				std::vector<T> rest;
+				rest.reserve(active);
+				for (size_t s = 0; s < shard_count; ++s)
+					rest.insert(rest.end(), shards[s].begin() + lo[s], shards[s].begin() + hi[s]);
+				std::nth_element(rest.begin(), rest.begin() + k, rest.end());
+				return rest[k];
+			}
+
+			std::sort(middles.begin(), middles.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			size_t weight = 0;
+			T pivot = middles.back().first;
+			for (const auto& [value, width] : middles)
+			{
+				weight += width;
+				if (2 * weight >= active)
+				{
+					pivot = value;
+					break;
+				}
+			}
+
+			size_t less = 0, less_equal = 0;
+			for (size_t s = 0; s < shard_count; ++s)
+			{
+				const T* first = shards[s].begin() + lo[s];
+				const T* last = shards[s].begin() + hi[s];
+				below[s] = lo[s] + static_cast<size_t>(std::lower_bound(first, last, pivot) - first);
+				through[s] = lo[s] + static_cast<size_t>(std::upper_bound(first, last, pivot) - first);
+				less += below[s] - lo[s];
+				less_equal += through[s] - lo[s];
+			}
+			if (k < less)
+			{
+				hi = below;
+			}
+			else if (k < less_equal)
+			{
+				return pivot;
+			}
+			else
+			{
+				k -= less_equal;
+				lo = through;
+			}
+		}
+	}
+
+	/**
+	 * @brief Calculate the percentile of the union of several sorted shards using
+	 * the same linear interpolation as BasicStats::percentile on their concatenation.
+	 *
+	 * @tparam T The type of the elements in the shards.
+	 * @param shards The shards, each sorted in ascending order.
+	 * @param p The percentile to calculate (0-100).
+	 * @return The value at the specified percentile.
+	 */
+	template<typename T>
+	double merged_percentile(const std::vector<span<const T>>& shards, double p)
+	{
+		size_t total = 0;
+		for (const span<const T>& shard : shards) total += shard.size();
+		if (total == 0) return 0.0;
+		if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+		double rank = (p / 100) * (total - 1);
+		size_t lower = static_cast<size_t>(std::floor(rank));
+		size_t upper = static_cast<size_t>(std::ceil(rank));
+		double weight = rank - lower;
+		double low_value = static_cast<double>(merged_kth_smallest(shards, lower));
+		if (upper == lower) return low_value;
+		return low_value + weight * (static_cast<double>(merged_kth_smallest(shards, upper)) - low_value);
+	}
+
+	/**
+	 * @brief Calculate the percentile of the union of several sorted vectors.
+	 *
+	 * @tparam T The type of the elements in the vectors.
+	 * @param shards The vectors, each sorted in ascending order.
+	 * @param p The percentile to calculate (0-100).
+	 * @return The value at the specified percentile.
+	 */
+	template<typename T>
+	double merged_percentile(const std::vector<std::vector<T>>& shards, double p)
+	{
+		return merged_percentile(std::vector<span<const T>>(shards.begin(), shards.end()), p);
+	}
+
+	/**
+	 * @brief Calculate the median of the union of several sorted shards.
+	 *
+	 * @tparam T The type of the elements in the shards.
+	 * @param shards The shards, each sorted in ascending order.
+	 * @return The median of the union of the shards.
+	 */
+	template<typename T>
+	double merged_median(const std::vector<span<const T>>& shards)
+	{
+		return merged_percentile(shards, 50);
+	}
+
+	/**
+	 * @brief Calculate the median of the union of several sorted vectors.
+	 *
+	 * @tparam T The type of the elements in the vectors.
+	 * @param shards The vectors, each sorted in ascending order.
+	 * @return The median of the union of the vectors.
+	 */
+	template<typename T>
+	double merged_median(const std::vector<std::vector<T>>& shards)
+	{
+		return merged_percentile(shards, 50);
+	}
+
+	/**
+	 * @brief Mergeable KLL quantile sketch.
+	 *
+	 * Keeps a hierarchy of compactors whose capacities shrink geometrically by 2/3
+	 * below the top level; items at level h stand for 2^h inputs. Memory is
+	 * O(k) items plus a logarithmic number of levels. With the default k = 200 the
+	 * normalised rank error of a percentile estimate is below about 1.65% with 99%
+	 * confidence, and it scales as 1/k. Minimum and maximum are tracked exactly.
+	 * NaN values have no rank; they are counted by nans() and kept out of the
+	 * compactors, count(), min() and max().
+	 */
+	class KllSketch
+	{
+	public:
+		/**
+		 * @brief Construct an empty sketch.
+		 *
+		 * @param k The accuracy parameter (at least 8).
+		 * @param seed The seed for the compaction coin flips.
+		 */
+		explicit KllSketch(unsigned int k = 200, unsigned int seed = 0x5eed)
+			: k_(std::max(k, 8u)), rng_(seed), levels_(1)
+		{
+			update_capacity();
+		}
+
+		/**
+		 * @brief Add a single value.
+		 *
+		 * @param value The value to add.
+		 */
+		void push(double value)
+		{
+			if (value != value)
+			{
+				++nans_;
+				return;
+			}
+			++count_;
+			min_ = std::min(min_, value);
+			max_ = std::max(max_, value);
+			levels_[0].push_back(value);
+			if (++retained_ >= total_capacity_) compress();
+		}
+
+		/**
+		 * @brief Add a contiguous batch of values.
+		 *
+		 * @tparam T The type of the values.
+		 * @param data Pointer to the first value.
+		 * @param n The number of values.
+		 */
+		template<typename T>
+		void push(const T* data, size_t n)
+		{
+			for (size_t i = 0; i < n; ++i) push(static_cast<double>(data[i]));
+		}
+
+		/**
+		 * @brief Combine another sketch into this one.
+		 *
+		 * @param other The sketch to merge.
+		 */
+		void merge(const KllSketch& other)
+		{
+			nans_ += other.nans_;
+			if (other.count_ == 0) return;
+			if (levels_.size() < other.levels_.size())
+			{
+				levels_.resize(other.levels_.size());
+				update_capacity();
+			}
+			for (size_t h = 0; h < other.levels_.size(); ++h)
+				levels_[h].insert(levels_[h].end(), other.levels_[h].begin(), other.levels_[h].end());
+			count_ += other.count_;
+			retained_ += other.retained_;
+			min_ = std::min(min_, other.min_);
+			max_ = std::max(max_, other.max_);
+			while (retained_ >= total_capacity_) compress();
+		}
+
+		/**
+		 * @brief Reset to the empty state, keeping the allocated storage.
+		 */
+		void clear()
+		{
+			for (std::vector<double>& level : levels_) level.clear();
+			levels_.resize(1);
+			update_capacity();
+			count_ = 0;
+			nans_ = 0;
+			retained_ = 0;
+			min_ = std::numeric_limits<double>::infinity();
+			max_ = -std::numeric_limits<double>::infinity();
+		}
+
+		/**
+		 * @brief The number of values summarised, not counting NaN values.
+		 */
+		size_t count() const { return count_; }
+
+		/**
+		 * @brief The number of NaN values rejected.
+		 */
+		size_t nans() const { return nans_; }
+
+		bool empty() const { return count_ == 0; }
+		unsigned int k() const { return k_; }
+		double min() const { return count_ == 0 ? 0.0 : min_; }
+		double max() const { return count_ == 0 ? 0.0 : max_; }
+
+		/**
+		 * @brief The number of items the sketch currently stores.
+		 */
+		size_t retained() const { return retained_; }
+
+		/**
+		 * @brief Estimate the fraction of inputs less than or equal to a value.
+		 *
+		 * @param value The value to look up.
+		 * @return The estimated CDF at value, in [0, 1].
+		 */
+		double cdf(double value) const
+		{
+			if (count_ == 0) return 0.0;
+			uint64_t weight = 0;
+			for (size_t h = 0; h < levels_.size(); ++h)
+			{
+				for (double item : levels_[h])
+				{
+					if (item <= value) weight += uint64_t(1) << h;
+				}
+			}
+			return static_cast<double>(weight) / count_;
+		}
+
+		/**
+		 * @brief Estimate a percentile using the same linear interpolation between
+		 * neighbouring ranks as BasicStats::percentile.
+		 *
+		 * @param p The percentile to calculate (0-100).
+		 * @return The estimated value at the specified percentile.
+		 */
+		double percentile(double p) const
+		{
+			if (count_ == 0) return 0.0;
+			if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+			std::vector<std::pair<double, uint64_t>> items;
+			items.reserve(retained());
+			for (size_t h = 0; h < levels_.size(); ++h)
+			{
+				for (double item : levels_[h]) items.emplace_back(item, uint64_t(1) << h);
+			}
+			std::sort(items.begin(), items.end());
+			double rank = (p / 100) * (count_ - 1);
+			auto value_at = [&](double r) {
+				if (r <= 0) return min_;
+				if (r >= count_ - 1) return max_;
+				uint64_t cumulative = 0;
+				for (const auto& [item, weight] : items)
+				{
+					cumulative += weight;
+					if (static_cast<double>(cumulative) > r) return item;
+				}
+				return max_;
+			};
+			double lower = std::floor(rank);
+			double low_value = value_at(lower);
+			if (rank == lower) return low_value;
+			return low_value + (rank - lower) * (value_at(std::ceil(rank)) - low_value);
+		}
+
+		/**
+		 * @brief The stored items of each level; items at level h have weight 2^h.
+		 */
+		const std::vector<std::vector<double>>& levels() const { return levels_; }
+
+		/**
+		 * @brief Rebuild a sketch from its raw state.
+		 *
+		 * @param k The accuracy parameter.
+		 * @param count The number of inputs summarised.
+		 * @param min The smallest input.
+		 * @param max The largest input.
+		 * @param levels The stored items of each level.
+		 * @param nans The number of NaN values rejected.
+		 * @return The sketch.
+		 */
+		static KllSketch from_state(unsigned int k, size_t count, double min, double max, std::vector<std::vector<double>> levels, size_t nans = 0)
+		{
+			KllSketch result(k);
+			result.nans_ = nans;
+			if (count == 0) return result;
+			if (levels.empty()) levels.emplace_back();
+			result.levels_ = std::move(levels);
+			result.update_capacity();
+			result.count_ = count;
+			result.retained_ = 0;
+			for (const std::vector<double>& level : result.levels_) result.retained_ += level.size();
+			result.min_ = min;
+			result.max_ = max;
+			return result;
+		}
+
+	private:
+		size_t capacity(size_t level) const
+		{
+			size_t depth = levels_.size() - 1 - level;
+			return std::max<size_t>(2, static_cast<size_t>(std::ceil(k_ * std::pow(2.0 / 3.0, static_cast<double>(depth)))));
+		}
+
+		void update_capacity()
+		{
+			total_capacity_ = 0;
+			for (size_t h = 0; h < levels_.size(); ++h) total_capacity_ += capacity(h);
+		}
+
+		// Compact the lowest level at or over its capacity: sort it and promote
+		// every other item, starting at a random offset, to the level above.
+		void compress()
+		{
+			for (size_t h = 0; h < levels_.size(); ++h)
+			{
+				if (levels_[h].size() < capacity(h)) continue;
+				if (h + 1 == levels_.size())
+				{
+					levels_.emplace_back();
+					update_capacity();
+				}
+				std::vector<double>& level = levels_[h];
+				std::sort(level.begin(), level.end());
+				double held = 0.0;
+				bool odd = level.size() % 2 == 1;
+				if (odd)
+				{
+					held = level.back();
+					level.pop_back();
+				}
+				size_t offset = static_cast<size_t>(rng_() & 1);
+				for (size_t i = offset; i < level.size(); i += 2) levels_[h + 1].push_back(level[i]);
+				retained_ -= level.size() / 2;
+				level.clear();
+				if (odd) level.push_back(held);
+				return;
+			}
+		}
+
+		unsigned int k_;
+		std::mt19937 rng_;
+		std::vector<std::vector<double>> levels_;
+		size_t count_ = 0;
+		size_t nans_ = 0;
+		size_t retained_ = 0;
+		size_t total_capacity_ = 0;
+		double min_ = std::numeric_limits<double>::infinity();
+		double max_ = -std::numeric_limits<double>::infinity();
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief Integer division rounding towards negative infinity.
+		 */
+		inline int64_t floor_div(int64_t a, int64_t b)
+		{
+			int64_t q = a / b;
+			return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+		}
+	}
+
+	/**
+	 * @brief Approximate percentiles over a sliding time window.
+	 *
+	 * The window is split into a ring of fixed-width intervals, each summarised by
+	 * a KllSketch. A segment tree of merged sketches sits on top of the ring and
+	 * only the paths above changed intervals are re-merged on query, so an update
+	 * costs one sketch insert and a query at most O(log m) merges per changed
+	 * interval for m intervals. Values older than the window are dropped.
+	 *
+	 * The error against BasicStats::percentile over the same window is the
+	 * KllSketch error for the window's sketch: a rank error below about 1.65% at
+	 * k = 200, plus the granularity of whole intervals at the window's trailing edge.
+	 */
+	class SlidingWindowQuantiles
+	{
+	public:
+		/**
+		 * @brief Construct an empty window.
+		 *
+		 * @param intervals The number of intervals in the window.
+		 * @param interval_width The width of one interval in timestamp units.
+		 * @param k The accuracy parameter of the interval sketches.
+		 */
+		SlidingWindowQuantiles(size_t intervals, int64_t interval_width, unsigned int k = 200)
+			: intervals_(intervals), width_(interval_width)
+		{
+			if (intervals == 0 || interval_width <= 0) throw std::invalid_argument("Window must have a positive number of intervals and width.");
+			while (leaves_ < intervals_) leaves_ *= 2;
+			tree_.assign(2 * leaves_, KllSketch(k));
+			dirty_.assign(2 * leaves_, false);
+		}
+
+		/**
+		 * @brief Add a timestamped value. Values older than the window are dropped.
+		 *
+		 * @param timestamp The timestamp of the value.
+		 * @param value The value to add.
+		 */
+		void push(int64_t timestamp, double value)
+		{
+			int64_t bucket = detail::floor_div(timestamp, width_);
+			advance_to(bucket);
+			if (bucket <= newest_ - static_cast<int64_t>(intervals_))
+			{
+				++dropped_;
+				return;
+			}
+			size_t slot = slot_of(bucket);
+			tree_[leaves_ + slot].push(value);
+			mark(slot);
+		}
+
+		/**
+		 * @brief Move the window forward to a timestamp without adding a value.
+		 *
+		 * @param timestamp The new current time.
+		 */
+		void advance(int64_t timestamp)
+		{
+			advance_to(detail::floor_div(timestamp, width_));
+		}
+
+		/**
+		 * @brief Estimate a percentile of the values in the window.
+		 *
+		 * @param p The percentile to calculate (0-100).
+		 * @return The estimated value at the specified percentile.
+		 */
+		double percentile(double p) const { return window().percentile(p); }
+
+		/**
+		 * @brief The number of values in the window.
+		 */
+		size_t count() const { return window().count(); }
+
+		/**
+		 * @brief The number of values dropped for arriving after their interval left the window.
+		 */
+		size_t dropped() const { return dropped_; }
+
+		/**
+		 * @brief The merged sketch of the whole window.
+		 */
+		const KllSketch& window() const
+		{
+			refresh(1);
+			return tree_[1];
+		}
+
+	private:
+		size_t slot_of(int64_t bucket) const
+		{
+			int64_t slot = bucket % static_cast<int64_t>(intervals_);
+			return static_cast<size_t>(slot < 0 ? slot + static_cast<int64_t>(intervals_) : slot);
+		}
+
+		void advance_to(int64_t bucket)
+		{
+			if (started_ && bucket <= newest_) return;
+			int64_t first = started_ ? std::max(newest_ + 1, bucket - static_cast<int64_t>(intervals_) + 1) : bucket - static_cast<int64_t>(intervals_) + 1;
+			for (int64_t b = first; b <= bucket; ++b)
+			{
+				size_t slot = slot_of(b);
+				tree_[leaves_ + slot].clear();
+				mark(slot);
+			}
+			newest_ = bucket;
+			started_ = true;
+		}
+
+		void mark(size_t slot)
+		{
+			for (size_t node = (leaves_ + slot) / 2; node > 0 && !dirty_[node]; node /= 2) dirty_[node] = true;
+		}
+
+		void refresh(size_t node) const
+		{
+			if (node >= leaves_ || !dirty_[node]) return;
+			refresh(2 * node);
+			refresh(2 * node + 1);
+			tree_[node].clear();
+			tree_[node].merge(tree_[2 * node]);
+			tree_[node].merge(tree_[2 * node + 1]);
+			dirty_[node] = false;
+		}
+
+		size_t intervals_;
+		int64_t width_;
+		size_t leaves_ = 1;
+		mutable std::vector<KllSketch> tree_;
+		mutable std::vector<bool> dirty_;
+		int64_t newest_ = 0;
+		bool started_ = false;
+		size_t dropped_ = 0;
+	};
+
+	/**
+	 * @brief Mergeable histogram with equal-width bins over [lower, upper).
+	 *
+	 * Values below or above the range are counted separately. Two histograms can
+	 * only be merged if they have the same range and number of bins.
+	 */
+	class Histogram
+	{
+	public:
+		/**
+		 * @brief Construct an empty histogram.
+		 *
+		 * @param lower The lower bound of the first bin.
+		 * @param upper The upper bound of the last bin.
+		 * @param bins The number of bins.
+		 */
+		Histogram(double lower = 0.0, double upper = 1.0, size_t bins = 64)
+			: lower_(lower), upper_(upper), scale_(bins / (upper - lower)), counts_(bins, 0)
+		{
+			if (bins == 0 || !(upper > lower)) throw std::invalid_argument("Histogram needs at least one bin and upper > lower.");
+		}
+
+		/**
+		 * @brief Add a single value.
+		 *
+		 * @param value The value to add.
+		 */
+		void push(double value)
+		{
+			// NaN fails both range checks and must not reach the bin index cast.
+			if (value != value)
+				++nans_;
+			else if (value < lower_)
+				++underflow_;
+			else if (value >= upper_)
+				++overflow_;
+			else
+				++counts_[std::min(counts_.size() - 1, static_cast<size_t>((value - lower_) * scale_))];
+		}
+
+		/**
+		 * @brief Add a contiguous batch of values.
+		 *
+		 * Each value goes through push(double), so NaN values are counted by nans() here too.
+		 *
+		 * @tparam T The type of the values.
+		 * @param data Pointer to the first value.
+		 * @param n The number of values.
+		 */
+		template<typename T>
+		void push(const T* data, size_t n)
+		{
+			for (size_t i = 0; i < n; ++i) push(static_cast<double>(data[i]));
+		}
+
+		/**
+		 * @brief Combine another histogram with the same layout into this one.
+		 *
+		 * @param other The histogram to merge.
+		 */
+		void merge(const Histogram& other)
+		{
+			if (other.lower_ != lower_ || other.upper_ != upper_ || other.counts_.size() != counts_.size())
+				throw std::invalid_argument("Histograms must have the same range and number of bins.");
+			for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+			underflow_ += other.underflow_;
+			overflow_ += other.overflow_;
+			nans_ += other.nans_;
+		}
+
+		/**
+		 * @brief Reset every count to zero, keeping the layout.
+		 */
+		void clear()
+		{
+			std::fill(counts_.begin(), counts_.end(), 0);
+			underflow_ = 0;
+			overflow_ = 0;
+			nans_ = 0;
+		}
+
+		/**
+		 * @brief Rebuild a histogram from its bin counts.
+		 *
+		 * @param lower The lower bound of the first bin.
+		 * @param upper The upper bound of the last bin.
+		 * @param counts The count of every bin.
+		 * @param underflow The number of values below lower.
+		 * @param overflow The number of values at or above upper.
+		 * @param nans The number of NaN values.
+		 * @return The histogram.
+		 */
+		static Histogram from_counts(double lower, double upper, std::vector<uint64_t> counts, uint64_t underflow, uint64_t overflow, uint64_t nans = 0)
+		{
+			Histogram result(lower, upper, counts.size());
+			result.counts_ = std::move(counts);
+			result.underflow_ = underflow;
+			result.overflow_ = overflow;
+			result.nans_ = nans;
+			return result;
+		}
+
+		double lower() const { return lower_; }
+		double upper() const { return upper_; }
+		size_t bin_count() const { return counts_.size(); }
+		const std::vector<uint64_t>& counts() const { return counts_; }
+		uint64_t underflow() const { return underflow_; }
+		uint64_t overflow() const { return overflow_; }
+		uint64_t nans() const { return nans_; }
+
+		/**
+		 * @brief The total number of values, including those out of range but not NaN values.
+		 */
+		uint64_t count() const
+		{
+			return std::accumulate(counts_.begin(), counts_.end(), underflow_ + overflow_);
+		}
+
+		/**
+		 * @brief Estimate a percentile by interpolating linearly within the bin
+		 * holding the requested rank. Ranks outside the range clamp to its bounds.
+		 *
+		 * @param p The percentile to calculate (0-100).
+		 * @return The estimated value at the specified percentile.
+		 */
+		double percentile(double p) const
+		{
+			uint64_t total = count();
+			if (total == 0) return 0.0;
+			if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+			double target = (p / 100) * total;
+			double cumulative = static_cast<double>(underflow_);
+			if (target <= cumulative) return lower_;
+			double width = (upper_ - lower_) / counts_.size();
+			for (size_t i = 0; i < counts_.size(); ++i)
+			{
+				if (counts_[i] > 0 && cumulative + counts_[i] >= target)
+					return lower_ + width * (i + (target - cumulative) / counts_[i]);
+				cumulative += counts_[i];
+			}
+			return upper_;
+		}
+
+	private:
+		double lower_;
+		double upper_;
+		double scale_;
+		std::vector<uint64_t> counts_;
+		uint64_t underflow_ = 0;
+		uint64_t overflow_ = 0;
+		uint64_t nans_ = 0;
+	};
+
+	/**
+	 * @brief Width and retained bucket count of one resolution of a RollupStore.
+	 */
+	struct RollupLevel
+	{
+		int64_t width;
+		size_t capacity;
+	};
+
+	/**
+	 * @brief Multi-resolution time rollup of mergeable accumulators.
+	 *
+	 * Each level keeps a fixed-size ring of buckets of one width, finest first.
+	 * A bucket that is pushed out of its ring is merged into the enclosing bucket
+	 * of the next coarser level, and buckets leaving the coarsest ring are
+	 * discarded, so memory is constant. Every value therefore lives in exactly one
+	 * bucket: recent data at fine resolution, older data at coarse resolution.
+	 * A range query merges the buckets that intersect it; a coarse bucket only
+	 * partly inside the range is included whole.
+	 *
+	 * @tparam Agg The accumulator type, providing push(double), merge(const Agg&) and clear().
+	 */
+	template<typename Agg = Moments>
+	class RollupStore
+	{
+	public:
+		/**
+		 * @brief Construct an empty store.
+		 *
+		 * @param levels The resolutions, finest first; each width must be a multiple of the previous one.
+		 * @param prototype An empty accumulator copied into every bucket.
+		 */
+		explicit RollupStore(std::vector<RollupLevel> levels, Agg prototype = Agg())
+			: levels_(std::move(levels)), prototype_(std::move(prototype))
+		{
+			if (levels_.empty()) throw std::invalid_argument("RollupStore needs at least one level.");
+			for (size_t l = 0; l < levels_.size(); ++l)
+			{
+				if (levels_[l].width <= 0 || levels_[l].capacity == 0)
+					throw std::invalid_argument("Rollup levels need a positive width and capacity.");
+				if (l > 0 && levels_[l].width % levels_[l - 1].width != 0)
+					throw std::invalid_argument("Each rollup width must be a multiple of the previous one.");
+				rings_.emplace_back(levels_[l].capacity, Bucket{ 0, false, prototype_ });
+			}
+		}
+
+		/**
+		 * @brief Add a timestamped value.
+		 *
+		 * NaN values are counted by nans() and never reach a bucket, where they
+		 * would poison the sums of every coarser level they are promoted into.
+		 *
+		 * @param timestamp The timestamp of the value.
+		 * @param value The value to add.
+		 */
+		void push(int64_t timestamp, double value)
+		{
+			if (value != value)
+			{
+				++nans_;
+				return;
+			}
+			for (size_t l = 0; l < levels_.size(); ++l)
+			{
+				Bucket* bucket = claim(l, detail::floor_div(timestamp, levels_[l].width));
+				if (bucket)
+				{
+					bucket->agg.push(value);
+					return;
+				}
+			}
+			++dropped_;
+		}
+
+		/**
+		 * @brief Merge the buckets intersecting the time range [first, last).
+		 *
+		 * @param first The start of the range.
+		 * @param last The end of the range.
+		 * @return The merged accumulator.
+		 */
+		Agg query(int64_t first, int64_t last) const
+		{
+			Agg result = prototype_;
+			result.clear();
+			for (size_t l = 0; l < levels_.size(); ++l)
+			{
+				int64_t width = levels_[l].width;
+				for (const Bucket& bucket : rings_[l])
+				{
+					if (bucket.used && bucket.index * width < last && (bucket.index + 1) * width > first)
+						result.merge(bucket.agg);
+				}
+			}
+			return result;
+		}
+
+		/**
+		 * @brief The number of values that arrived too late for any retained bucket.
+		 */
+		size_t dropped() const { return dropped_; }
+
+		/**
+		 * @brief The number of NaN values rejected.
+		 */
+		size_t nans() const { return nans_; }
+
+	private:
+		struct Bucket
+		{
+			int64_t index;
+			bool used;
+			Agg agg;
+		};
+
+		// Find or open the bucket for index at level l, promoting whatever older
+		// bucket occupies its slot. Returns null if the slot already holds newer
+		// data, meaning the value belongs to a coarser level.
+		Bucket* claim(size_t l, int64_t index)
+		{
+			std::vector<Bucket>& ring = rings_[l];
+			int64_t capacity = static_cast<int64_t>(ring.size());
+			Bucket& bucket = ring[static_cast<size_t>(((index % capacity) + capacity) % capacity)];
+			if (bucket.used && bucket.index == index) return &bucket;
+			if (bucket.used && bucket.index > index) return nullptr;
+			if (bucket.used) promote(l, bucket);
+			bucket.index = index;
+			bucket.used = true;
+			bucket.agg.clear();
+			return &bucket;
+		}
+
+		void promote(size_t l, const Bucket& bucket)
+		{
+			int64_t start = bucket.index * levels_[l].width;
+			for (size_t next = l + 1; next < levels_.size(); ++next)
+			{
+				Bucket* target = claim(next, detail::floor_div(start, levels_[next].width));
+				if (target)
+				{
+					target->agg.merge(bucket.agg);
+					return;
+				}
+			}
+		}
+
+		std::vector<RollupLevel> levels_;
+		Agg prototype_;
+		std::vector<std::vector<Bucket>> rings_;
+		size_t dropped_ = 0;
+		size_t nans_ = 0;
+	};
+
+	/**
+	 * @brief The kinds of time window supported by WindowAggregator.
+	 */
+	enum class WindowKind
+	{
+		tumbling,
+		hopping,
+		session
+	};
+
+	/**
+	 * @brief Shape of the windows produced by a WindowAggregator.
+	 */
+	struct WindowSpec
+	{
+		WindowKind kind = WindowKind::tumbling;
+		int64_t size = 1;
+		int64_t slide = 1;
+		int64_t gap = 0;
+
+		/**
+		 * @brief Back-to-back windows [k * size, (k + 1) * size).
+		 */
+		static WindowSpec tumbling(int64_t size) { return { WindowKind::tumbling, size, size, 0 }; }
+
+		/**
+		 * @brief Overlapping windows [k * slide, k * slide + size).
+		 */
+		static WindowSpec hopping(int64_t size, int64_t slide) { return { WindowKind::hopping, size, slide, 0 }; }
+
+		/**
+		 * @brief Windows of activity that close after gap time units without a value.
+		 */
+		static WindowSpec session(int64_t gap) { return { WindowKind::session, 0, 0, gap }; }
+	};
+
+	/**
+	 * @brief Single-pass windowed aggregation over a timestamped stream.
+	 *
+	 * Values may arrive out of order. The watermark trails the largest timestamp
+	 * seen by the allowed lateness; a window is emitted once its end is at or
+	 * before the watermark, and values that only belong to already emitted windows
+	 * are dropped. Accumulators of emitted windows are cleared and reused, so no
+	 * allocation happens per window once the pool has warmed up.
+	 *
+	 * @tparam Agg The accumulator type, providing push(double), merge(const Agg&) and clear().
+	 */
+	template<typename Agg = Moments>
+	class WindowAggregator
+	{
+	public:
+		using Callback = std::function<void(int64_t start, int64_t end, const Agg& result)>;
+
+		/**
+		 * @brief Construct an aggregator.
+		 *
+		 * @param spec The window shape.
+		 * @param allowed_lateness How far behind the largest timestamp values may arrive.
+		 * @param emit Called with [start, end) and the accumulator of every closed window, in order of end.
+		 * @param prototype An empty accumulator copied for every window.
+		 */
+		WindowAggregator(WindowSpec spec, int64_t allowed_lateness, Callback emit, Agg prototype = Agg())
+			: spec_(spec), lateness_(allowed_lateness), emit_(std::move(emit)), prototype_(std::move(prototype))
+		{
+			bool valid = spec_.kind == WindowKind::session
+				? spec_.gap > 0
+				: spec_.size > 0 && spec_.slide > 0 && spec_.slide <= spec_.size;
+			if (!valid || allowed_lateness < 0) throw std::invalid_argument("Invalid window specification.");
+		}
+
+		/**
+		 * @brief Add a timestamped value and emit any windows the watermark has passed.
+		 *
+		 * @param timestamp The timestamp of the value.
+		 * @param value The value to add.
+		 */
+		void push(int64_t timestamp, double value)
+		{
+			bool accepted = spec_.kind == WindowKind::session ? push_session(timestamp, value) : push_fixed(timestamp, value);
+			if (!accepted) ++dropped_;
+			if (!started_ || timestamp > max_timestamp_)
+			{
+				max_timestamp_ = timestamp;
+				started_ = true;
+				emit_until(max_timestamp_ - lateness_);
+			}
+		}
+
+		/**
+		 * @brief Emit every open window, as if the stream had ended.
+		 */
+		void flush()
+		{
+			emit_until(std::numeric_limits<int64_t>::max());
+		}
+
+		/**
+		 * @brief The current watermark; windows ending at or before it are closed.
+		 */
+		int64_t watermark() const
+		{
+			return started_ ? max_timestamp_ - lateness_ : std::numeric_limits<int64_t>::min();
+		}
+
+		/**
+		 * @brief The number of values that arrived after all of their windows closed.
+		 */
+		size_t dropped() const { return dropped_; }
+
+		/**
+		 * @brief The number of windows currently open.
+		 */
+		size_t open_windows() const { return open_.size(); }
+
+	private:
+		struct Window
+		{
+			int64_t start;
+			int64_t end;
+			size_t slot;
+		};
+
+		bool closed(int64_t end) const { return started_ && end <= max_timestamp_ - lateness_; }
+
+		size_t acquire()
+		{
+			if (free_.empty())
+			{
+				pool_.push_back(prototype_);
+				pool_.back().clear();
+				return pool_.size() - 1;
+			}
+			size_t slot = free_.back();
+			free_.pop_back();
+			return slot;
+		}
+
+		// Open windows are kept sorted by start; there are only a handful of them.
+		Window& find_or_open(int64_t start, int64_t end)
+		{
+			auto it = std::lower_bound(open_.begin(), open_.end(), start, [](const Window& w, int64_t s) { return w.start < s; });
+			if (it != open_.end() && it->start == start) return *it;
+			return *open_.insert(it, Window{ start, end, acquire() });
+		}
+
+		bool push_fixed(int64_t timestamp, double value)
+		{
+			bool accepted = false;
+			int64_t start = detail::floor_div(timestamp, spec_.slide) * spec_.slide;
+			for (; start > timestamp - spec_.size; start -= spec_.slide)
+			{
+				if (closed(start + spec_.size)) break;
+				pool_[find_or_open(start, start + spec_.size).slot].push(value);
+				accepted = true;
+			}
+			return accepted;
+		}
+
+		bool push_session(int64_t timestamp, double value)
+		{
+			int64_t end = timestamp + spec_.gap;
+			if (closed(end)) return false;
+			// The first session the value is closer than gap to, on either side, so
+			// that the sessions do not depend on arrival order.
+			auto it = std::find_if(open_.begin(), open_.end(), [&](const Window& w) {
+				return timestamp > w.start - spec_.gap && timestamp < w.end;
+			});
+			if (it == open_.end())
+			{
+				Window& window = find_or_open(timestamp, end);
+				window.end = std::max(window.end, end);
+				pool_[window.slot].push(value);
+				return true;
+			}
+			it->start = std::min(it->start, timestamp);
+			it->end = std::max(it->end, end);
+			pool_[it->slot].push(value);
+			auto next = it + 1;
+			while (next != open_.end() && next->start < it->end)
+			{
+				pool_[it->slot].merge(pool_[next->slot]);
+				it->end = std::max(it->end, next->end);
+				release(next->slot);
+				next = open_.erase(next);
+				it = next - 1;
+			}
+			return true;
+		}
+
+		void release(size_t slot)
+		{
+			pool_[slot].clear();
+			free_.push_back(slot);
+		}
+
+		void emit_until(int64_t watermark)
+		{
+			while (true)
+			{
+				auto first = std::min_element(open_.begin(), open_.end(), [](const Window& a, const Window& b) { return a.end < b.end; });
+				if (first == open_.end() || first->end > watermark) return;
+				Window window = *first;
+				open_.erase(first);
+				emit_(window.start, window.end, pool_[window.slot]);
+				release(window.slot);
+			}
+		}
+
+		WindowSpec spec_;
+		int64_t lateness_;
+		Callback emit_;
+		Agg prototype_;
+		std::vector<Window> open_;
+		std::vector<Agg> pool_;
+		std::vector<size_t> free_;
+		int64_t max_timestamp_ = 0;
+		bool started_ = false;
+		size_t dropped_ = 0;
+	};
+
+	/**
+	 * @brief Aggregate timestamp and value columns into windows in a single pass.
+	 *
+	 * @tparam Agg The accumulator type.
+	 * @tparam T The type of the values.
+	 * @param timestamps The timestamp of every value.
+	 * @param values The values.
+	 * @param spec The window shape.
+	 * @param allowed_lateness How far behind the largest timestamp values may arrive.
+	 * @param emit Called with [start, end) and the accumulator of every window.
+	 * @param prototype An empty accumulator copied for every window.
+	 * @return The number of values dropped as too late.
+	 */
+	template<typename Agg = Moments, typename T>
+	size_t aggregate_windows(const std::vector<int64_t>& timestamps, const std::vector<T>& values, WindowSpec spec, int64_t allowed_lateness,
+		typename WindowAggregator<Agg>::Callback emit, Agg prototype = Agg())
+	{
+		if (timestamps.size() != values.size()) throw std::invalid_argument("Timestamp and value vectors must be of the same size.");
+		WindowAggregator<Agg> aggregator(spec, allowed_lateness, std::move(emit), std::move(prototype));
+		for (size_t i = 0; i < values.size(); ++i) aggregator.push(timestamps[i], static_cast<double>(values[i]));
+		aggregator.flush();
+		return aggregator.dropped();
+	}
+
+	/**
+	 * @brief Concurrent recorder with one shard per writer thread and interval snapshots.
+	 *
+	 * Each writer owns a shard holding two accumulators. It records into the
+	 * active one with plain, unshared writes, and brackets each record with
+	 * stores to two sequence counters only it writes, so the fast path has no
+	 * read-modify-write atomics and no locks. snapshot() flips every shard to its
+	 * other accumulator, waits only for a record already in flight on the old one
+	 * to finish, then merges and clears the old accumulators. Writers are never
+	 * paused.
+	 *
+	 * @tparam Agg The accumulator type, providing push(double), merge(const Agg&) and clear().
+	 */
+	template<typename Agg = Moments>
+	class ConcurrentRecorder
+	{
+		struct Shard;
+
+	public:
+		/**
+		 * @brief Handle through which one thread records values.
+		 *
+		 * A writer must not be used by more than one thread at a time.
+		 */
+		class Writer
+		{
+		public:
+			/**
+			 * @brief Record a single value.
+			 *
+			 * @param value The value to record.
+			 */
+			void record(double value)
+			{
+				uint64_t sequence = shard_->begin.load(std::memory_order_relaxed) + 1;
+				shard_->begin.store(sequence, std::memory_order_seq_cst);
+				unsigned int active = shard_->active.load(std::memory_order_seq_cst);
+				shard_->buffers[active].push(value);
+				shard_->end.store(sequence, std::memory_order_release);
+			}
+
+		private:
+			friend class ConcurrentRecorder;
+
+			explicit Writer(Shard* shard)
+				: shard_(shard)
+			{
+			}
+
+			Shard* shard_;
+		};
+
+		/**
+		 * @brief Construct an empty recorder.
+		 *
+		 * @param prototype An empty accumulator copied into every shard.
+		 */
+		explicit ConcurrentRecorder(Agg prototype = Agg())
+			: prototype_(std::move(prototype))
+		{
+			prototype_.clear();
+		}
+
+		/**
+		 * @brief Register a writer shard for the calling thread.
+		 *
+		 * Registration takes a lock; keep the returned writer for the lifetime of
+		 * the thread rather than registering per record.
+		 *
+		 * @return A writer bound to a new shard owned by this recorder.
+		 */
+		Writer writer()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			shards_.push_back(std::make_unique<Shard>(prototype_));
+			return Writer(shards_.back().get());
+		}
+
+		/**
+		 * @brief Collect everything recorded since the previous snapshot.
+		 *
+		 * @return The merged accumulator of the interval.
+		 */
+		Agg snapshot()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			Agg result = prototype_;
+			for (const std::unique_ptr<Shard>& shard : shards_)
+			{
+				unsigned int old = shard->active.load(std::memory_order_relaxed);
+				shard->active.store(1 - old, std::memory_order_seq_cst);
+				// A record that began before the flip may still be writing to the old buffer.
+				uint64_t in_flight = shard->begin.load(std::memory_order_seq_cst);
+				while (shard->end.load(std::memory_order_acquire) < in_flight) std::this_thread::yield();
+				result.merge(shard->buffers[old]);
+				shard->buffers[old].clear();
+			}
+			return result;
+		}
+
+	private:
+		struct Shard
+		{
+			explicit Shard(const Agg& prototype)
+				: buffers{ prototype, prototype }
+			{
+			}
+
+			alignas(64) std::atomic<uint64_t> begin{ 0 };
+			std::atomic<uint64_t> end{ 0 };
+			std::atomic<unsigned int> active{ 0 };
+			Agg buffers[2];
+		};
+
+		Agg prototype_;
+		std::mutex mutex_;
+		std::vector<std::unique_ptr<Shard>> shards_;
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief The smallest power of two not less than n.
+		 */
+		inline size_t next_power_of_two(size_t n)
+		{
+			size_t result = 1;
+			while (result < n) result *= 2;
+			return result;
+		}
+	}
+
+	/**
+	 * @brief Bounded lock-free single-producer single-consumer ring.
+	 *
+	 * Head and tail live on separate cache lines, and each side caches the other
+	 * side's index so that it only reloads it when the ring looks full or empty.
+	 *
+	 * @tparam T The element type.
+	 */
+	template<typename T>
+	class SpscRing
+	{
+	public:
+		using value_type = T;
+		static constexpr bool supports_overwrite = false;
+
+		/**
+		 * @brief Construct a ring holding at least capacity elements.
+		 *
+		 * @param capacity The minimum capacity; rounded up to a power of two.
+		 */
+		explicit SpscRing(size_t capacity)
+			: buffer_(detail::next_power_of_two(std::max<size_t>(capacity, 2))), mask_(buffer_.size() - 1)
+		{
+		}
+
+		size_t capacity() const { return buffer_.size(); }
+
+		/**
+		 * @brief The approximate number of queued elements.
+		 */
+		size_t size() const
+		{
+			// Head first: it never passes the tail, so a later tail cannot make the difference wrap.
+			size_t head = head_.load(std::memory_order_acquire);
+			size_t tail = tail_.load(std::memory_order_acquire);
+			return tail > head ? tail - head : 0;
+		}
+
+		/**
+		 * @brief Enqueue a value; producer only.
+		 *
+		 * @return False if the ring is full.
+		 */
+		bool try_push(const T& value)
+		{
+			size_t tail = tail_.load(std::memory_order_relaxed);
+			if (tail - head_cache_ == buffer_.size())
+			{
+				head_cache_ = head_.load(std::memory_order_acquire);
+				if (tail - head_cache_ == buffer_.size()) return false;
+			}
+			buffer_[tail & mask_] = value;
+			tail_.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		/**
+		 * @brief Dequeue up to max values into out; consumer only.
+		 *
+		 * @return The number of values dequeued.
+		 */
+		size_t try_pop_batch(T* out, size_t max)
+		{
+			size_t head = head_.load(std::memory_order_relaxed);
+			if (tail_cache_ == head) tail_cache_ = tail_.load(std::memory_order_acquire);
+			size_t n = std::min(max, tail_cache_ - head);
+			for (size_t i = 0; i < n; ++i) out[i] = buffer_[(head + i) & mask_];
+			head_.store(head + n, std::memory_order_release);
+			return n;
+		}
+
+	private:
+		std::vector<T> buffer_;
+		size_t mask_;
+		alignas(64) std::atomic<size_t> head_{ 0 };
+		size_t tail_cache_ = 0;
+		alignas(64) std::atomic<size_t> tail_{ 0 };
+		size_t head_cache_ = 0;
+	};
+
+	/**
+	 * @brief Bounded lock-free multi-producer ring.
+	 *
+	 * Every cell carries a sequence number that tells producers and consumers
+	 * whether it is free or full for the current lap, so producers only contend
+	 * on the tail index. Popping is also safe from several threads, which lets a
+	 * producer evict the oldest value when the ring is full.
+	 *
+	 * @tparam T The element type.
+	 */
+	template<typename T>
+	class MpscRing
+	{
+	public:
+		using value_type = T;
+		static constexpr bool supports_overwrite = true;
+
+		/**
+		 * @brief Construct a ring holding at least capacity elements.
+		 *
+		 * @param capacity The minimum capacity; rounded up to a power of two.
+		 */
+		explicit MpscRing(size_t capacity)
+			: cells_(detail::next_power_of_two(std::max<size_t>(capacity, 2))), mask_(cells_.size() - 1)
+		{
+			for (size_t i = 0; i < cells_.size(); ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		size_t capacity() const { return cells_.size(); }
+
+		/**
+		 * @brief The approximate number of queued elements.
+		 */
+		size_t size() const
+		{
+			size_t head = head_.load(std::memory_order_acquire);
+			size_t tail = tail_.load(std::memory_order_acquire);
+			return tail > head ? tail - head : 0;
+		}
+
+		/**
+		 * @brief Enqueue a value; safe from any number of threads.
+		 *
+		 * @return False if the ring is full.
+		 */
+		bool try_push(const T& value)
+		{
+			size_t position = tail_.load(std::memory_order_relaxed);
+			while (true)
+			{
+				Cell& cell = cells_[position & mask_];
+				size_t sequence = cell.sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+				if (diff == 0)
+				{
+					if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						cell.value = value;
+						cell.sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = tail_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/**
+		 * @brief Dequeue one value; safe from any number of threads.
+		 *
+		 * @return False if the ring is empty.
+		 */
+		bool try_pop(T& out)
+		{
+			size_t position = head_.load(std::memory_order_relaxed);
+			while (true)
+			{
+				Cell& cell = cells_[position & mask_];
+				size_t sequence = cell.sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+				if (diff == 0)
+				{
+					if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					{
+						out = cell.value;
+						cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = head_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/**
+		 * @brief Dequeue up to max values into out.
+		 *
+		 * @return The number of values dequeued.
+		 */
+		size_t try_pop_batch(T* out, size_t max)
+		{
+			size_t n = 0;
+			while (n < max && try_pop(out[n])) ++n;
+			return n;
+		}
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> sequence{ 0 };
+			T value{};
+		};
+
+		std::vector<Cell> cells_;
+		size_t mask_;
+		alignas(64) std::atomic<size_t> head_{ 0 };
+		alignas(64) std::atomic<size_t> tail_{ 0 };
+	};
+
+	/**
+	 * @brief What an IngestAggregator producer does when the ring is full.
+	 */
+	enum class BackPressure
+	{
+		drop,      // discard the new value
+		block,     // spin until there is room
+		overwrite  // evict the oldest queued value (MpscRing only)
+	};
+
+	/**
+	 * @brief Background aggregation fed through a lock-free ring.
+	 *
+	 * Producers hand values to the ring and return immediately; a dedicated thread
+	 * drains it in batches into the accumulator's batch push. With an SpscRing,
+	 * push() must only be called from one thread.
+	 *
+	 * @tparam Agg The accumulator type, providing push(const T*, size_t).
+	 * @tparam Ring The ring type, SpscRing or MpscRing.
+	 */
+	template<typename Agg = Moments, typename Ring = MpscRing<double>>
+	class IngestAggregator
+	{
+	public:
+		using value_type = typename Ring::value_type;
+
+		/**
+		 * @brief Start the aggregation thread.
+		 *
+		 * @param capacity The ring capacity.
+		 * @param policy What to do when the ring is full.
+		 * @param prototype The initial accumulator.
+		 * @param batch_size The maximum number of values drained per batch.
+		 */
+		explicit IngestAggregator(size_t capacity, BackPressure policy = BackPressure::block, Agg prototype = Agg(), size_t batch_size = 4096)
+			: ring_(capacity), policy_(policy), agg_(std::move(prototype)), batch_(std::max<size_t>(batch_size, 1))
+		{
+			if (policy_ == BackPressure::overwrite && !Ring::supports_overwrite)
+				throw std::invalid_argument("Overwrite back-pressure needs a ring that supports concurrent pops.");
+			worker_ = std::thread([this]() { run(); });
+		}
+
+		IngestAggregator(const IngestAggregator&) = delete;
+		IngestAggregator& operator=(const IngestAggregator&) = delete;
+
+		~IngestAggregator() { stop(); }
+
+		/**
+		 * @brief Hand a value to the aggregation thread.
+		 *
+		 * Once stop() has been called a blocking push on a full ring drops the
+		 * value instead of waiting for a drain that will not come.
+		 *
+		 * @param value The value to record.
+		 * @return False if the value was dropped.
+		 */
+		bool push(const value_type& value)
+		{
+			if (ring_.try_push(value)) return true;
+			switch (policy_)
+			{
+			case BackPressure::drop:
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			case BackPressure::block:
+				while (!ring_.try_push(value))
+				{
+					if (stopping_.load(std::memory_order_acquire))
+					{
+						dropped_.fetch_add(1, std::memory_order_relaxed);
+						return false;
+					}
+					std::this_thread::yield();
+				}
+				return true;
+			case BackPressure::overwrite:
+				while (!ring_.try_push(value))
+				{
+					if constexpr (Ring::supports_overwrite)
+					{
+						value_type evicted;
+						if (ring_.try_pop(evicted)) overwritten_.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+				return true;
+			}
+			return false;
+		}
+
+		/**
+		 * @brief Drain the ring and stop the aggregation thread.
+		 *
+		 * Values pushed after stop() has been called are not aggregated; they
+		 * may sit in the ring until it is full, after which pushes fail.
+		 */
+		void stop()
+		{
+			if (!worker_.joinable()) return;
+			stopping_.store(true, std::memory_order_release);
+			worker_.join();
+		}
+
+		/**
+		 * @brief Wait until every value pushed so far has been aggregated.
+		 *
+		 * Returns early once stop() has been called; stop() itself drains the ring.
+		 */
+		void flush() const
+		{
+			while ((ring_.size() > 0 || busy_.load(std::memory_order_acquire)) && !stopping_.load(std::memory_order_acquire))
+				std::this_thread::yield();
+		}
+
+		/**
+		 * @brief A copy of the accumulator as of the last drained batch.
+		 */
+		Agg snapshot() const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return agg_;
+		}
+
+		size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+		size_t overwritten() const { return overwritten_.load(std::memory_order_relaxed); }
+		size_t processed() const { return processed_.load(std::memory_order_relaxed); }
+		size_t depth() const { return ring_.size(); }
+
+	private:
+		void run()
+		{
+			std::vector<value_type> batch(batch_);
+			unsigned int idle = 0;
+			while (true)
+			{
+				busy_.store(true, std::memory_order_release);
+				size_t n = ring_.try_pop_batch(batch.data(), batch.size());
+				if (n > 0)
+				{
+					{
+						std::lock_guard<std::mutex> lock(mutex_);
+						agg_.push(batch.data(), n);
+					}
+					processed_.fetch_add(n, std::memory_order_relaxed);
+					busy_.store(false, std::memory_order_release);
+					idle = 0;
+					continue;
+				}
+				busy_.store(false, std::memory_order_release);
+				if (stopping_.load(std::memory_order_acquire) && ring_.size() == 0) return;
+				if (++idle < 64)
+					std::this_thread::yield();
+				else
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+
+		Ring ring_;
+		BackPressure policy_;
+		Agg agg_;
+		size_t batch_;
+		mutable std::mutex mutex_;
+		std::thread worker_;
+		std::atomic<bool> stopping_{ false };
+		std::atomic<bool> busy_{ false };
+		std::atomic<size_t> dropped_{ 0 };
+		std::atomic<size_t> overwritten_{ 0 };
+		std::atomic<size_t> processed_{ 0 };
+	};
+
+#if defined(__unix__) || defined(__APPLE__)
+	namespace detail
+	{
+		/**
+		 * @brief Header at the start of a shared statistics segment.
+		 */
+		struct SharedStatsHeader
+		{
+			static constexpr uint32_t magic_value = 0x42535348; // "BSSH"
+			static constexpr uint32_t current_version = 2;
+
+			uint32_t magic;
+			uint32_t version;
+			uint64_t max_bins;
+			alignas(64) std::atomic<uint64_t> sequence;
+		};
+
+		// Payload word offsets; bins follow the fixed fields.
+		enum SharedStatsWord : size_t
+		{
+			word_count,
+			word_mean,
+			word_m2,
+			word_min,
+			word_max,
+			word_bin_count,
+			word_lower,
+			word_upper,
+			word_underflow,
+			word_overflow,
+			word_nans,
+			word_bins
+		};
+
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared statistics need lock-free 64-bit atomics.");
+
+		inline size_t shared_stats_size(size_t max_bins)
+		{
+			return sizeof(SharedStatsHeader) + (word_bins + max_bins) * sizeof(std::atomic<uint64_t>);
+		}
+
+		inline uint64_t to_word(double value)
+		{
+			uint64_t word;
+			std::memcpy(&word, &value, sizeof(word));
+			return word;
+		}
+
+		inline double from_word(uint64_t word)
+		{
+			double value;
+			std::memcpy(&value, &word, sizeof(value));
+			return value;
+		}
+	}
+
+	/**
+	 * @brief Consistent copy of the statistics read from a shared segment.
+	 */
+	struct PublishedStats
+	{
+		Moments moments;
+		bool has_histogram = false;
+		Histogram histogram;
+		uint64_t generation = 0;
+	};
+
+	/**
+	 * @brief Publishes accumulators into a POSIX shared-memory segment.
+	 *
+	 * Updates are versioned with a sequence lock: the sequence is odd while a
+	 * publish is in progress, and every payload word is an atomic written and read
+	 * with relaxed ordering, so readers in other processes retry instead of
+	 * blocking the writer. Only one thread may publish to a segment.
+	 */
+	class SharedStatsPublisher
+	{
+	public:
+		/**
+		 * @brief Create and map a fresh named segment.
+		 *
+		 * A stale segment of the same name is unlinked rather than reused, so
+		 * readers still mapping it keep a consistent (if frozen) snapshot instead
+		 * of watching it be zeroed or truncated under them. They see new data
+		 * once they reopen the name.
+		 *
+		 * @param name The shm_open name, starting with '/'.
+		 * @param max_bins The largest histogram the segment can hold.
+		 */
+		explicit SharedStatsPublisher(const std::string& name, size_t max_bins = 256)
+			: size_(detail::shared_stats_size(max_bins))
+		{
+			::shm_unlink(name.c_str());
+			int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+			if (fd < 0) throw std::runtime_error("shm_open failed for " + name + ".");
+			if (::ftruncate(fd, static_cast<off_t>(size_)) != 0)
+			{
+				::close(fd);
+				throw std::runtime_error("ftruncate failed for " + name + ".");
+			}
+			void* address = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (address == MAP_FAILED) throw std::runtime_error("mmap failed for " + name + ".");
+			base_ = static_cast<unsigned char*>(address);
+			header_ = new (base_) detail::SharedStatsHeader{ 0, 0, max_bins, {} };
+			header_->sequence.store(0, std::memory_order_relaxed);
+			words_ = reinterpret_cast<std::atomic<uint64_t>*>(base_ + sizeof(detail::SharedStatsHeader));
+			for (size_t i = 0; i < detail::word_bins + max_bins; ++i) new (&words_[i]) std::atomic<uint64_t>(0);
+			header_->version = detail::SharedStatsHeader::current_version;
+			std::atomic_thread_fence(std::memory_order_release);
+			header_->magic = detail::SharedStatsHeader::magic_value;
+		}
+
+		SharedStatsPublisher(const SharedStatsPublisher&) = delete;
+		SharedStatsPublisher& operator=(const SharedStatsPublisher&) = delete;
+
+		~SharedStatsPublisher()
+		{
+			::munmap(base_, size_);
+		}
+
+		/**
+		 * @brief Publish new statistics.
+		 *
+		 * @param moments The moment accumulator to publish.
+		 * @param histogram An optional histogram with at most max_bins bins.
+		 */
+		void publish(const Moments& moments, const Histogram* histogram = nullptr)
+		{
+			size_t bins = histogram ? histogram->bin_count() : 0;
+			if (bins > header_->max_bins) throw std::invalid_argument("Histogram has more bins than the shared segment holds.");
+			uint64_t sequence = header_->sequence.load(std::memory_order_relaxed);
+			header_->sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			store(detail::word_count, moments.count());
+			store(detail::word_mean, detail::to_word(moments.mean()));
+			store(detail::word_m2, detail::to_word(moments.m2()));
+			store(detail::word_min, detail::to_word(moments.min()));
+			store(detail::word_max, detail::to_word(moments.max()));
+			store(detail::word_bin_count, bins);
+			if (histogram)
+			{
+				store(detail::word_lower, detail::to_word(histogram->lower()));
+				store(detail::word_upper, detail::to_word(histogram->upper()));
+				store(detail::word_underflow, histogram->underflow());
+				store(detail::word_overflow, histogram->overflow());
+				store(detail::word_nans, histogram->nans());
+				for (size_t i = 0; i < bins; ++i) store(detail::word_bins + i, histogram->counts()[i]);
+			}
+			header_->sequence.store(sequence + 2, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Remove a segment name; mapped segments stay valid until unmapped.
+		 *
+		 * @param name The shm_open name.
+		 */
+		static void unlink(const std::string& name)
+		{
+			::shm_unlink(name.c_str());
+		}
+
+	private:
+		void store(size_t word, uint64_t value)
+		{
+			words_[word].store(value, std::memory_order_relaxed);
+		}
+
+		size_t size_;
+		unsigned char* base_ = nullptr;
+		detail::SharedStatsHeader* header_ = nullptr;
+		std::atomic<uint64_t>* words_ = nullptr;
+	};
+
+	/**
+	 * @brief Read-only view of a segment written by a SharedStatsPublisher, for
+	 * use from another process. Reads never block the writer.
+	 */
+	class SharedStatsReader
+	{
+	public:
+		/**
+		 * @brief Map an existing segment read-only.
+		 *
+		 * @param name The shm_open name used by the publisher.
+		 */
+		explicit SharedStatsReader(const std::string& name)
+		{
+			int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+			if (fd < 0) throw std::runtime_error("shm_open failed for " + name + ".");
+			struct stat info;
+			if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < detail::shared_stats_size(0))
+			{
+				::close(fd);
+				throw std::runtime_error("Shared statistics segment " + name + " is too small.");
+			}
+			size_ = static_cast<size_t>(info.st_size);
+			void* address = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (address == MAP_FAILED) throw std::runtime_error("mmap failed for " + name + ".");
+			base_ = static_cast<const unsigned char*>(address);
+			header_ = reinterpret_cast<const detail::SharedStatsHeader*>(base_);
+			words_ = reinterpret_cast<const std::atomic<uint64_t>*>(base_ + sizeof(detail::SharedStatsHeader));
+			if (header_->magic != detail::SharedStatsHeader::magic_value || header_->version != detail::SharedStatsHeader::current_version
+				|| detail::shared_stats_size(header_->max_bins) > size_)
+			{
+				::munmap(const_cast<unsigned char*>(base_), size_);
+				throw std::runtime_error("Segment " + name + " does not hold shared statistics of a supported version.");
+			}
+		}
+
+		SharedStatsReader(const SharedStatsReader&) = delete;
+		SharedStatsReader& operator=(const SharedStatsReader&) = delete;
+
+		~SharedStatsReader()
+		{
+			::munmap(const_cast<unsigned char*>(base_), size_);
+		}
+
+		/**
+		 * @brief Attempt one consistent read.
+		 *
+		 * @param out Receives the statistics on success.
+		 * @return False if a publish was in progress or overlapped the read.
+		 */
+		bool try_read(PublishedStats& out) const
+		{
+			uint64_t before = header_->sequence.load(std::memory_order_acquire);
+			if (before % 2 == 1) return false;
+			size_t bins = static_cast<size_t>(std::min<uint64_t>(load(detail::word_bin_count), header_->max_bins));
+			Moments moments(static_cast<size_t>(load(detail::word_count)), detail::from_word(load(detail::word_mean)),
+				detail::from_word(load(detail::word_m2)), detail::from_word(load(detail::word_min)), detail::from_word(load(detail::word_max)));
+			double lower = detail::from_word(load(detail::word_lower));
+			double upper = detail::from_word(load(detail::word_upper));
+			uint64_t underflow = load(detail::word_underflow);
+			uint64_t overflow = load(detail::word_overflow);
+			uint64_t nans = load(detail::word_nans);
+			std::vector<uint64_t> counts(bins);
+			for (size_t i = 0; i < bins; ++i) counts[i] = load(detail::word_bins + i);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (header_->sequence.load(std::memory_order_relaxed) != before) return false;
+
+			out.moments = moments;
+			out.has_histogram = bins > 0;
+			if (out.has_histogram) out.histogram = Histogram::from_counts(lower, upper, std::move(counts), underflow, overflow, nans);
+			out.generation = before / 2;
+			return true;
+		}
+
+		/**
+		 * @brief Read a consistent snapshot, retrying while the writer is mid-publish.
+		 */
+		PublishedStats read() const
+		{
+			PublishedStats result;
+			while (!try_read(result)) std::this_thread::yield();
+			return result;
+		}
+
+	private:
+		uint64_t load(size_t word) const
+		{
+			return words_[word].load(std::memory_order_relaxed);
+		}
+
+		const unsigned char* base_ = nullptr;
+		size_t size_ = 0;
+		const detail::SharedStatsHeader* header_ = nullptr;
+		const std::atomic<uint64_t>* words_ = nullptr;
+	};
+#endif
+
+	/**
+	 * @brief Mergeable state of a bootstrap: the statistic of every resample.
+	 *
+	 * Replicates computed on different nodes over resamples of the same
+	 * population merge by concatenation, so the interval can be taken over all
+	 * of them without shipping the data.
+	 */
+	class BootstrapReplicates
+	{
+	public:
+		/**
+		 * @brief Add the statistic of one resample.
+		 *
+		 * @param value The statistic.
+		 */
+		void push(double value)
+		{
+			replicates_.push_back(value);
+		}
+
+		/**
+		 * @brief Add a contiguous batch of replicates.
+		 *
+		 * @tparam T The type of the values.
+		 * @param data Pointer to the first value.
+		 * @param n The number of values.
+		 */
+		template<typename T>
+		void push(const T* data, size_t n)
+		{
+			replicates_.insert(replicates_.end(), data, data + n);
+		}
+
+		/**
+		 * @brief Append the replicates of another state.
+		 *
+		 * @param other The state to merge.
+		 */
+		void merge(const BootstrapReplicates& other)
+		{
+			replicates_.insert(replicates_.end(), other.replicates_.begin(), other.replicates_.end());
+		}
+
+		/**
+		 * @brief Remove every replicate.
+		 */
+		void clear()
+		{
+			replicates_.clear();
+		}
+
+		size_t count() const { return replicates_.size(); }
+		const std::vector<double>& replicates() const { return replicates_; }
+
+		/**
+		 * @brief The percentile interval of the replicates.
+		 *
+		 * @param confidence_level The confidence level (0-100).
+		 * @return A pair containing the lower and upper bounds of the confidence interval.
+		 */
+		std::pair<double, double> confidence_interval(double confidence_level) const
+		{
+			if (replicates_.empty()) return { 0.0, 0.0 };
+			if (confidence_level <= 0 || confidence_level >= 100) throw std::out_of_range("Confidence level must be between 0 and 100.");
+			std::vector<double> storage;
+			const std::vector<double>& sorted = detail::sorted_view(replicates_, storage);
+			double alpha = (100 - confidence_level) / 2;
+			return { detail::sorted_percentile(sorted.begin(), sorted.end(), alpha),
+				detail::sorted_percentile(sorted.begin(), sorted.end(), 100 - alpha) };
+		}
+
+	private:
+		std::vector<double> replicates_;
+	};
+
+	/**
+	 * @brief Compute bootstrap replicates of a statistic.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param func The function to apply to the resampled data; every parallel task calls its own copy.
+	 * @param nmax The number of bootstrap samples to generate.
+	 * @return The replicate state, which can be merged with others before taking an interval.
+	 */
+	template<typename T, typename Function>
+	BootstrapReplicates bootstrap_replicates(const std::vector<T>& data, Function func, unsigned int nmax = 1024)
+	{
+		static_assert(std::is_invocable_r_v<double, Function, const std::vector<T>&>, "Function must return double and accept a vector of T.");
+		BootstrapReplicates result;
+		if (data.empty()) return result;
+		std::vector<double> replicates = detail::bootstrap_statistics<double, true>(nmax, func, [&](Function& f) { return f(resample(data)); });
+		result.push(replicates.data(), replicates.size());
+		return result;
+	}
+
+	/**
+	 * @brief Type tags of the serialized states.
+	 */
+	enum class SerializedType : uint8_t
+	{
+		moments = 1,
+		histogram = 2,
+		kll_sketch = 3,
+		bootstrap_replicates = 4
+	};
+
+	namespace detail
+	{
+		inline constexpr uint8_t serial_magic[2] = { 'B', 'S' };
+		inline constexpr uint8_t serial_version = 1;
+		inline constexpr size_t serial_header_size = 4;
+
+		/**
+		 * @brief Appends little-endian and LEB128 encoded fields to a byte buffer.
+		 */
+		class ByteWriter
+		{
+		public:
+			void header(SerializedType type)
+			{
+				bytes_.insert(bytes_.end(), { serial_magic[0], serial_magic[1], static_cast<uint8_t>(type), serial_version });
+			}
+
+			void varint(uint64_t value)
+			{
+				while (value >= 0x80)
+				{
+					bytes_.push_back(static_cast<uint8_t>(value | 0x80));
+					value >>= 7;
+				}
+				bytes_.push_back(static_cast<uint8_t>(value));
+			}
+
+			void signed_varint(int64_t value)
+			{
+				varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+			}
+
+			void fixed64(uint64_t value)
+			{
+				for (int i = 0; i < 8; ++i) bytes_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+			}
+
+			void real(double value)
+			{
+				uint64_t word;
+				std::memcpy(&word, &value, sizeof(word));
+				fixed64(word);
+			}
+
+			void reals(const double* data, size_t n)
+			{
+				varint(n);
+				bytes_.reserve(bytes_.size() + 8 * n);
+				for (size_t i = 0; i < n; ++i) real(data[i]);
+			}
+
+			std::vector<uint8_t> take() { return std::move(bytes_); }
+
+		private:
+			std::vector<uint8_t> bytes_;
+		};
+
+		/**
+		 * @brief Reads fields written by ByteWriter directly from the caller's buffer.
+		 */
+		class ByteReader
+		{
+		public:
+			explicit ByteReader(span<const uint8_t> bytes)
+				: bytes_(bytes)
+			{
+			}
+
+			void header(SerializedType type)
+			{
+				need(serial_header_size);
+				if (bytes_[0] != serial_magic[0] || bytes_[1] != serial_magic[1])
+					throw std::invalid_argument("Buffer does not hold serialized statistics.");
+				if (bytes_[2] != static_cast<uint8_t>(type))
+					throw std::invalid_argument("Buffer holds a different serialized type.");
+				if (bytes_[3] == 0 || bytes_[3] > serial_version)
+					throw std::invalid_argument("Unsupported serialization version.");
+				position_ = serial_header_size;
+			}
+
+			uint64_t varint()
+			{
+				uint64_t value = 0;
+				for (unsigned int shift = 0; shift < 64; shift += 7)
+				{
+					need(1);
+					uint8_t byte = bytes_[position_++];
+					value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+					if ((byte & 0x80) == 0) return value;
+				}
+				throw std::invalid_argument("Malformed varint in serialized statistics.");
+			}
+
+			int64_t signed_varint()
+			{
+				uint64_t value = varint();
+				return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+			}
+
+			uint64_t fixed64()
+			{
+				need(8);
+				uint64_t value = 0;
+				for (int i = 0; i < 8; ++i) value |= static_cast<uint64_t>(bytes_[position_ + i]) << (8 * i);
+				position_ += 8;
+				return value;
+			}
+
+			double real()
+			{
+				uint64_t word = fixed64();
+				double value;
+				std::memcpy(&value, &word, sizeof(value));
+				return value;
+			}
+
+			std::vector<double> reals()
+			{
+				uint64_t n = varint();
+				if (n > (bytes_.size() - position_) / 8) throw std::invalid_argument("Serialized statistics are truncated.");
+				std::vector<double> values(static_cast<size_t>(n));
+				for (double& value : values) value = real();
+				return values;
+			}
+
+			void finish() const
+			{
+				if (position_ != bytes_.size()) throw std::invalid_argument("Trailing bytes after serialized statistics.");
+			}
+
+		private:
+			void need(size_t n) const
+			{
+				if (bytes_.size() - position_ < n) throw std::invalid_argument("Serialized statistics are truncated.");
+			}
+
+			span<const uint8_t> bytes_;
+			size_t position_ = 0;
+		};
+
+		template<typename T>
+		struct Codec;
+
+		template<>
+		struct Codec<Moments>
+		{
+			static constexpr SerializedType type = SerializedType::moments;
+
+			static void write(ByteWriter& out, const Moments& m)
+			{
+				out.varint(m.count());
+				out.real(m.mean());
+				out.real(m.m2());
+				out.real(m.min());
+				out.real(m.max());
+			}
+
+			static Moments read(ByteReader& in)
+			{
+				size_t count = static_cast<size_t>(in.varint());
+				double mean = in.real();
+				double m2 = in.real();
+				double min = in.real();
+				double max = in.real();
+				return Moments(count, mean, m2, min, max);
+			}
+		};
+
+		// Bin counts are written as zigzag deltas from the previous bin, which
+		// keeps smooth distributions to one or two bytes per bin.
+		template<>
+		struct Codec<Histogram>
+		{
+			static constexpr SerializedType type = SerializedType::histogram;
+
+			static void write(ByteWriter& out, const Histogram& h)
+			{
+				out.real(h.lower());
+				out.real(h.upper());
+				out.varint(h.underflow());
+				out.varint(h.overflow());
+				out.varint(h.nans());
+				out.varint(h.bin_count());
+				uint64_t previous = 0;
+				for (uint64_t count : h.counts())
+				{
+					out.signed_varint(static_cast<int64_t>(count - previous));
+					previous = count;
+				}
+			}
+
+			static Histogram read(ByteReader& in)
+			{
+				double lower = in.real();
+				double upper = in.real();
+				uint64_t underflow = in.varint();
+				uint64_t overflow = in.varint();
+				uint64_t nans = in.varint();
+				uint64_t bins = in.varint();
+				std::vector<uint64_t> counts;
+				uint64_t previous = 0;
+				for (uint64_t i = 0; i < bins; ++i)
+				{
+					previous += static_cast<uint64_t>(in.signed_varint());
+					counts.push_back(previous);
+				}
+				return Histogram::from_counts(lower, upper, std::move(counts), underflow, overflow, nans);
+			}
+		};
+
+		template<>
+		struct Codec<KllSketch>
+		{
+			static constexpr SerializedType type = SerializedType::kll_sketch;
+
+			static void write(ByteWriter& out, const KllSketch& s)
+			{
+				out.varint(s.k());
+				out.varint(s.count());
+				out.varint(s.nans());
+				out.real(s.min());
+				out.real(s.max());
+				out.varint(s.levels().size());
+				for (const std::vector<double>& level : s.levels()) out.reals(level.data(), level.size());
+			}
+
+			static KllSketch read(ByteReader& in)
+			{
+				uint64_t k = in.varint();
+				if (k == 0 || k > std::numeric_limits<unsigned int>::max()) throw std::invalid_argument("Serialized KLL sketch has an invalid k.");
+				size_t count = static_cast<size_t>(in.varint());
+				size_t nans = static_cast<size_t>(in.varint());
+				double min = in.real();
+				double max = in.real();
+				uint64_t height = in.varint();
+				if (height > 64) throw std::invalid_argument("Serialized KLL sketch has too many levels.");
+				std::vector<std::vector<double>> levels;
+				for (uint64_t h = 0; h < height; ++h) levels.push_back(in.reals());
+				return KllSketch::from_state(static_cast<unsigned int>(k), count, min, max, std::move(levels), nans);
+			}
+		};
+
+		template<>
+		struct Codec<BootstrapReplicates>
+		{
+			static constexpr SerializedType type = SerializedType::bootstrap_replicates;
+
+			static void write(ByteWriter& out, const BootstrapReplicates& b)
+			{
+				out.reals(b.replicates().data(), b.count());
+			}
+
+			static BootstrapReplicates read(ByteReader& in)
+			{
+				std::vector<double> replicates = in.reals();
+				BootstrapReplicates result;
+				result.push(replicates.data(), replicates.size());
+				return result;
+			}
+		};
+	}
+
+	/**
+	 * @brief Encode a mergeable state into a compact, versioned byte buffer.
+	 *
+	 * Every buffer starts with the bytes 'B' 'S', a type tag and the format
+	 * version. Counts are LEB128 varints, histogram bins are zigzag deltas and
+	 * doubles are packed little-endian, so buffers are portable across hosts.
+	 *
+	 * @tparam T Moments, Histogram, KllSketch or BootstrapReplicates.
+	 * @param state The state to encode.
+	 * @return The encoded bytes.
+	 */
+	template<typename T>
+	std::vector<uint8_t> serialize(const T& state)
+	{
+		detail::ByteWriter out;
+		out.header(detail::Codec<T>::type);
+		detail::Codec<T>::write(out, state);
+		return out.take();
+	}
+
+	/**
+	 * @brief Decode a state written by serialize().
+	 *
+	 * Decoding reads straight from the given bytes, which are not copied first,
+	 * and allocates only the storage of the decoded state itself, such as the
+	 * histogram bins or the sketch levels.
+	 *
+	 * @tparam T The type that was serialized.
+	 * @param bytes The encoded bytes.
+	 * @return The decoded state.
+	 */
+	template<typename T>
+	T deserialize(span<const uint8_t> bytes)
+	{
+		detail::ByteReader in(bytes);
+		in.header(detail::Codec<T>::type);
+		T result = detail::Codec<T>::read(in);
+		in.finish();
+		return result;
+	}
+
+	/**
+	 * @brief Identify the state held by an encoded buffer, e.g. to dispatch on it.
+	 *
+	 * @param bytes The encoded bytes.
+	 * @return The type tag.
+	 */
+	inline SerializedType serialized_type(span<const uint8_t> bytes)
+	{
+		if (bytes.size() < detail::serial_header_size || bytes[0] != detail::serial_magic[0] || bytes[1] != detail::serial_magic[1])
+			throw std::invalid_argument("Buffer does not hold serialized statistics.");
+		return static_cast<SerializedType>(bytes[2]);
+	}
+
+	namespace detail
+	{
+		/**
+		 * @brief Merge the states [first, last) pairwise in a balanced tree.
+		 *
+		 * Every state takes part in O(log n) merges of similarly sized operands,
+		 * which for Moments keeps the Chan update's error growth logarithmic and
+		 * for sketches keeps compactions balanced across inputs.
+		 *
+		 * Runs of up to eight states at the leaves are folded into a copy of their
+		 * first state, which saves a copy per state for accumulators that are
+		 * expensive to copy, such as sketches carrying their own generator.
+		 *
+		 * @param get Callable returning the state at an index.
+		 */
+		template<typename Agg, typename Get>
+		Agg balanced_merge(size_t first, size_t last, const Get& get)
+		{
+			constexpr size_t leaf = 8;
+			if (last - first <= leaf)
+			{
+				Agg result(get(first));
+				for (size_t i = first + 1; i < last; ++i) result.merge(get(i));
+				return result;
+			}
+			size_t middle = first + (last - first) / 2;
+			Agg left = balanced_merge<Agg>(first, middle, get);
+			left.merge(balanced_merge<Agg>(middle, last, get));
+			return left;
+		}
+
+		/**
+		 * @brief Reduce n states with a balanced merge tree whose lower levels run in parallel.
+		 */
+		template<typename Agg, typename Get>
+		Agg tree_merge(size_t n, size_t grain, const Get& get)
+		{
+			if (n == 0) return Agg();
+			grain = std::max<size_t>(grain, 1);
+			size_t chunks = std::min(worker_count(), (n + grain - 1) / grain);
+			if (chunks <= 1) return balanced_merge<Agg>(0, n, get);
+			// Equal chunks keep the combined tree balanced across chunk boundaries.
+			std::vector<std::unique_ptr<Agg>> partials(chunks);
+			parallel_for(chunks, 1, [&](size_t cb, size_t ce) {
+				for (size_t c = cb; c < ce; ++c)
+					partials[c] = std::make_unique<Agg>(balanced_merge<Agg>(c * n / chunks, (c + 1) * n / chunks, get));
+			});
+			return balanced_merge<Agg>(0, chunks, [&](size_t c) -> const Agg& { return *partials[c]; });
+		}
+	}
+
+	/**
+	 * @brief Merge many partial states in a balanced tree, in parallel.
+	 *
+	 * Compared with a serial left fold this shortens the critical path to
+	 * O(n / threads + log n) merges, and the pairwise Chan updates of Moments
+	 * accumulate rounding error in O(log n) rather than O(n) steps.
+	 *
+	 * @tparam Agg The accumulator type, providing merge(const Agg&).
+	 * @param parts The partial states.
+	 * @param grain The minimum number of states merged per thread.
+	 * @return The merged state, or Agg() if parts is empty.
+	 */
+	template<typename Agg>
+	Agg tree_merge(span<const Agg> parts, size_t grain = grain_size(ParallelAlgorithm::merge))
+	{
+		return detail::tree_merge<Agg>(parts.size(), grain, [&](size_t i) -> const Agg& { return parts[i]; });
+	}
+
+	/**
+	 * @brief Merge many partial states in a balanced tree, in parallel.
+	 *
+	 * @tparam Agg The accumulator type, providing merge(const Agg&).
+	 * @param parts The partial states.
+	 * @param grain The minimum number of states merged per thread.
+	 * @return The merged state, or Agg() if parts is empty.
+	 */
+	template<typename Agg>
+	Agg tree_merge(const std::vector<Agg>& parts, size_t grain = grain_size(ParallelAlgorithm::merge))
+	{
+		return tree_merge(span<const Agg>(parts), grain);
+	}
+
+	/**
+	 * @brief Decode and merge many serialized partial states in a balanced tree, in parallel.
+	 *
+	 * States are decoded at the leaves of the tree, so decoding is spread over
+	 * the threads as well.
+	 *
+	 * @tparam Agg The type that was serialized.
+	 * @param parts The encoded states.
+	 * @param grain The minimum number of states merged per thread.
+	 * @return The merged state, or Agg() if parts is empty.
+	 */
+	template<typename Agg>
+	Agg tree_merge_serialized(const std::vector<span<const uint8_t>>& parts, size_t grain = grain_size(ParallelAlgorithm::merge))
+	{
+		return detail::tree_merge<Agg>(parts.size(), grain, [&](size_t i) { return deserialize<Agg>(parts[i]); });
+	}
+
+	/**
+	 * @brief Decode and merge many serialized partial states in a balanced tree, in parallel.
+	 *
+	 * @tparam Agg The type that was serialized.
+	 * @param parts The encoded states.
+	 * @param grain The minimum number of states merged per thread.
+	 * @return The merged state, or Agg() if parts is empty.
+	 */
+	template<typename Agg>
+	Agg tree_merge_serialized(const std::vector<std::vector<uint8_t>>& parts, size_t grain = grain_size(ParallelAlgorithm::merge))
+	{
+		return tree_merge_serialized<Agg>(std::vector<span<const uint8_t>>(parts.begin(), parts.end()), grain);
+	}
+
+	namespace detail
+	{
+		/**
+		 * @brief Parse a Linux CPU list such as "0-3,8-11".
+		 */
+		inline std::vector<unsigned int> parse_cpu_list(const std::string& list)
+		{
+			std::vector<unsigned int> cpus;
+			size_t position = 0;
+			while (position < list.size())
+			{
+				size_t comma = std::min(list.find(',', position), list.size());
+				std::string item = list.substr(position, comma - position);
+				position = comma + 1;
+				if (item.empty() || !std::isdigit(static_cast<unsigned char>(item[0]))) continue;
+				size_t dash = item.find('-');
+				unsigned long first = std::stoul(item.substr(0, dash));
+				unsigned long last = dash == std::string::npos ? first : std::stoul(item.substr(dash + 1));
+				for (unsigned long cpu = first; cpu <= last; ++cpu) cpus.push_back(static_cast<unsigned int>(cpu));
+			}
+			return cpus;
+		}
+
+		/**
+		 * @brief Restrict the calling thread to a set of CPUs; a no-op where unsupported.
+		 */
+		inline void pin_current_thread(const std::vector<unsigned int>& cpus)
+		{
+#if defined(__linux__)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for (unsigned int cpu : cpus)
+			{
+				if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+			}
+			pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+			(void)cpus;
+#endif
+		}
+	}
+
+	/**
+	 * @brief The NUMA nodes of a machine and the CPUs belonging to each.
+	 */
+	struct NumaTopology
+	{
+		std::vector<std::vector<unsigned int>> node_cpus;
+		bool simulated = false;
+
+		size_t nodes() const { return node_cpus.size(); }
+
+		/**
+		 * @brief Read the topology of this machine.
+		 *
+		 * @return The nodes listed under /sys/devices/system/node on Linux, or a
+		 * single node holding every hardware thread elsewhere.
+		 */
+		static NumaTopology detect()
+		{
+			NumaTopology topology;
+#if defined(__linux__)
+			for (unsigned int node = 0;; ++node)
+			{
+				std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+				std::string list;
+				if (!file || !std::getline(file, list)) break;
+				std::vector<unsigned int> cpus = detail::parse_cpu_list(list);
+				if (!cpus.empty()) topology.node_cpus.push_back(std::move(cpus));
+			}
+#endif
+			if (topology.node_cpus.empty())
+			{
+				topology.node_cpus.emplace_back(detail::hardware_threads());
+				std::iota(topology.node_cpus[0].begin(), topology.node_cpus[0].end(), 0u);
+			}
+			return topology;
+		}
+
+		/**
+		 * @brief A made-up topology for exercising the NUMA code paths on any
+		 * machine. Threads are not pinned and placement is logical only.
+		 *
+		 * @param nodes The number of nodes.
+		 * @param cpus_per_node The number of CPUs on each node.
+		 */
+		static NumaTopology simulated_topology(size_t nodes, size_t cpus_per_node)
+		{
+			if (nodes == 0 || cpus_per_node == 0) throw std::invalid_argument("A topology needs at least one node and one CPU per node.");
+			NumaTopology topology;
+			topology.simulated = true;
+			for (size_t node = 0; node < nodes; ++node)
+			{
+				topology.node_cpus.emplace_back(cpus_per_node);
+				std::iota(topology.node_cpus[node].begin(), topology.node_cpus[node].end(), static_cast<unsigned int>(node * cpus_per_node));
+			}
+			return topology;
+		}
+	};
+
+	/**
+	 * @brief Executor with one work-stealing pool per NUMA node, its workers
+	 * pinned to the node's CPUs.
+	 *
+	 * As the default executor it sends chunk c of a parallel loop with C chunks
+	 * to node c * nodes / C, the node that owns that slice of a partitioned
+	 * NumaArray, so loops over such arrays mostly read local memory. The
+	 * placement is best effort: the calling thread claims chunks too, starting
+	 * with the last, and idle workers help with chunks not yet started. Use
+	 * reduce_by_node when every read must stay on its node.
+	 */
+	class NumaExecutor : public Executor
+	{
+	public:
+		/**
+		 * @brief Start a pool on every node.
+		 *
+		 * @param topology The topology to follow.
+		 */
+		explicit NumaExecutor(NumaTopology topology = NumaTopology::detect())
+			: topology_(std::move(topology))
+		{
+			if (topology_.nodes() == 0) throw std::invalid_argument("A topology needs at least one node.");
+			for (const std::vector<unsigned int>& cpus : topology_.node_cpus)
+			{
+				std::function<void(size_t)> pin;
+				if (!topology_.simulated) pin = [cpus](size_t) { detail::pin_current_thread(cpus); };
+				pools_.push_back(std::make_unique<ThreadPool>(std::max<size_t>(cpus.size(), 1), pin));
+				concurrency_ += pools_.back()->concurrency();
+			}
+		}
+
+		size_t concurrency() const override { return concurrency_; }
+
+		void execute(std::function<void()> task, size_t hint) override
+		{
+			pools_[node_of_chunk(hint % concurrency_, concurrency_)]->execute(std::move(task), hint);
+		}
+
+		void execute_chunk(std::function<void()> task, size_t chunk, size_t chunks) override
+		{
+			pools_[node_of_chunk(chunk, chunks)]->execute(std::move(task), chunk);
+		}
+
+		/**
+		 * @brief The node that runs chunk c of a loop with C chunks.
+		 */
+		size_t node_of_chunk(size_t chunk, size_t chunks) const
+		{
+			return chunk * pools_.size() / chunks;
+		}
+
+		/**
+		 * @brief Run a task on one node's pool.
+		 *
+		 * @param node The node.
+		 * @param task The task to run; it must not throw.
+		 */
+		void execute_on(size_t node, std::function<void()> task)
+		{
+			pools_.at(node)->execute(std::move(task), 0);
+		}
+
+		size_t nodes() const { return pools_.size(); }
+		size_t node_workers(size_t node) const { return pools_.at(node)->concurrency(); }
+		const NumaTopology& topology() const { return topology_; }
+
+	private:
+		NumaTopology topology_;
+		std::vector<std::unique_ptr<ThreadPool>> pools_;
+		size_t concurrency_ = 0;
+	};
+
+	/**
+	 * @brief How the pages of a NumaArray are spread over the nodes.
+	 */
+	enum class NumaPlacement
+	{
+		partitioned,  // node k holds the k-th contiguous slice
+		interleaved   // pages are dealt to the nodes round-robin
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief Run fn(node, worker) once for every worker of every node on that
+		 * node's pool and wait for all of them. Must not be called from a task of
+		 * the same executor.
+		 */
+		template<typename Function>
+		void run_on_every_worker(NumaExecutor& executor, Function fn)
+		{
+			struct Latch
+			{
+				std::mutex mutex;
+				std::condition_variable done;
+				size_t remaining = 0;
+				std::exception_ptr error;
+			} latch;
+			for (size_t node = 0; node < executor.nodes(); ++node) latch.remaining += executor.node_workers(node);
+			for (size_t node = 0; node < executor.nodes(); ++node)
+			{
+				for (size_t worker = 0; worker < executor.node_workers(node); ++worker)
+				{
+					executor.execute_on(node, [&latch, &fn, node, worker]() {
+						std::exception_ptr error;
+						try { fn(node, worker); }
+						catch (...) { error = std::current_exception(); }
+						std::lock_guard<std::mutex> lock(latch.mutex);
+						if (error && !latch.error) latch.error = error;
+						if (--latch.remaining == 0) latch.done.notify_all();
+					});
+				}
+			}
+			std::unique_lock<std::mutex> lock(latch.mutex);
+			latch.done.wait(lock, [&]() { return latch.remaining == 0; });
+			if (latch.error) std::rethrow_exception(latch.error);
+		}
+	}
+
+	/**
+	 * @brief Fixed-size array whose pages are placed on NUMA nodes by first touch.
+	 *
+	 * The storage is page aligned and left untouched by the allocator; each page
+	 * is then first written by a worker of the node that should hold it, so the
+	 * kernel's default local allocation places it there.
+	 *
+	 * @tparam T The element type; must be trivially copyable.
+	 */
+	template<typename T>
+	class NumaArray
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "NumaArray elements must be trivially copyable.");
+
+	public:
+		/**
+		 * @brief Allocate a zero-filled array.
+		 *
+		 * @param n The number of elements.
+		 * @param placement How to spread the pages over the nodes.
+		 * @param executor The executor whose node workers touch the pages.
+		 */
+		NumaArray(size_t n, NumaPlacement placement, NumaExecutor& executor)
+			: NumaArray(n, placement, executor, nullptr)
+		{
+		}
+
+		/**
+		 * @brief Allocate an array holding a copy of data.
+		 *
+		 * @param data The values to copy.
+		 * @param placement How to spread the pages over the nodes.
+		 * @param executor The executor whose node workers touch the pages.
+		 */
+		NumaArray(const std::vector<T>& data, NumaPlacement placement, NumaExecutor& executor)
+			: NumaArray(data.size(), placement, executor, data.data())
+		{
+		}
+
+		NumaArray(const NumaArray&) = delete;
+		NumaArray& operator=(const NumaArray&) = delete;
+
+		~NumaArray()
+		{
+			if (data_) ::operator delete(data_, std::align_val_t(page_bytes));
+		}
+
+		T* data() { return data_; }
+		const T* data() const { return data_; }
+		size_t size() const { return size_; }
+		T& operator[](size_t i) { return data_[i]; }
+		const T& operator[](size_t i) const { return data_[i]; }
+		T* begin() { return data_; }
+		T* end() { return data_ + size_; }
+		const T* begin() const { return data_; }
+		const T* end() const { return data_ + size_; }
+		NumaPlacement placement() const { return placement_; }
+		size_t nodes() const { return nodes_; }
+
+		/**
+		 * @brief The node holding an element.
+		 *
+		 * @param i The index of the element.
+		 */
+		size_t node_of(size_t i) const
+		{
+			return node_of_page(i / page_size);
+		}
+
+		/**
+		 * @brief Call fn(pointer, length) for the contiguous runs of one worker's
+		 * share of the pages held by a node.
+		 *
+		 * @param node The node.
+		 * @param worker The worker index within the node.
+		 * @param workers The number of workers on the node.
+		 * @param fn The function to call.
+		 */
+		template<typename Function>
+		void for_each_local_run(size_t node, size_t worker, size_t workers, Function fn) const
+		{
+			size_t local = local_pages(node);
+			size_t first = worker * local / workers, last = (worker + 1) * local / workers;
+			if (placement_ == NumaPlacement::partitioned)
+			{
+				if (first == last) return;
+				size_t begin = (partition_start(node) + first) * page_size;
+				size_t end = std::min(size_, (partition_start(node) + last) * page_size);
+				if (begin < end) fn(data_ + begin, end - begin);
+				return;
+			}
+			for (size_t j = first; j < last; ++j)
+			{
+				size_t begin = (node + j * nodes_) * page_size;
+				fn(data_ + begin, std::min(size_, begin + page_size) - begin);
+			}
+		}
+
+	private:
+		static constexpr size_t page_bytes = 4096;
+		static constexpr size_t page_size = detail::page_elements<T>();
+
+		NumaArray(size_t n, NumaPlacement placement, NumaExecutor& executor, const T* source)
+			: size_(n), pages_((n + page_size - 1) / page_size), nodes_(executor.nodes()), placement_(placement)
+		{
+			if (n == 0) return;
+			data_ = static_cast<T*>(::operator new(pages_ * page_bytes, std::align_val_t(page_bytes)));
+			detail::run_on_every_worker(executor, [&](size_t node, size_t worker) {
+				for_each_local_run(node, worker, executor.node_workers(node), [&](const T* run, size_t length) {
+					T* target = data_ + (run - data_);
+					if (source)
+						std::memcpy(static_cast<void*>(target), source + (run - data_), length * sizeof(T));
+					else
+						std::memset(static_cast<void*>(target), 0, length * sizeof(T));
+				});
+			});
+		}
+
+		size_t partition_start(size_t node) const { return node * pages_ / nodes_; }
+
+		size_t node_of_page(size_t page) const
+		{
+			if (placement_ == NumaPlacement::interleaved) return page % nodes_;
+			size_t node = std::min(nodes_ - 1, page * nodes_ / pages_);
+			while (node + 1 < nodes_ && partition_start(node + 1) <= page) ++node;
+			while (partition_start(node) > page) --node;
+			return node;
+		}
+
+		size_t local_pages(size_t node) const
+		{
+			if (placement_ == NumaPlacement::partitioned) return partition_start(node + 1) - partition_start(node);
+			return node < pages_ % nodes_ ? pages_ / nodes_ + 1 : pages_ / nodes_;
+		}
+
+		T* data_ = nullptr;
+		size_t size_;
+		size_t pages_;
+		size_t nodes_;
+		NumaPlacement placement_;
+	};
+
+	/**
+	 * @brief Aggregate a NumaArray with every node reading only its own pages.
+	 *
+	 * Each worker aggregates its share of its node's pages. The worker partials
+	 * of each node are merged into a per-node partial, and those are merged last. Must not be called from a task of the same executor.
+	 *
+	 * @tparam Agg The accumulator type, providing push(const T*, size_t) and merge().
+	 * @tparam T The element type.
+	 * @param data The array.
+	 * @param executor The executor the array was placed with.
+	 * @param prototype An empty accumulator copied for every worker.
+	 * @return The merged accumulator.
+	 */
+	template<typename Agg = Moments, typename T>
+	Agg reduce_by_node(const NumaArray<T>& data, NumaExecutor& executor, Agg prototype = Agg())
+	{
+		if (data.nodes() != executor.nodes()) throw std::invalid_argument("NumaArray was placed for a different number of nodes.");
+		std::vector<std::vector<std::unique_ptr<Agg>>> partials(executor.nodes());
+		for (size_t node = 0; node < executor.nodes(); ++node) partials[node].resize(executor.node_workers(node));
+		detail::run_on_every_worker(executor, [&](size_t node, size_t worker) {
+			auto local = std::make_unique<Agg>(prototype);
+			data.for_each_local_run(node, worker, executor.node_workers(node), [&](const T* run, size_t length) { local->push(run, length); });
+			partials[node][worker] = std::move(local);
+		});
+		std::vector<std::unique_ptr<Agg>> per_node;
+		for (std::vector<std::unique_ptr<Agg>>& workers : partials)
+		{
+			per_node.push_back(std::make_unique<Agg>(detail::balanced_merge<Agg>(0, workers.size(),
+				[&](size_t w) -> const Agg& { return *workers[w]; })));
+		}
+		return detail::balanced_merge<Agg>(0, per_node.size(), [&](size_t n) -> const Agg& { return *per_node[n]; });
+	}
+
+	/**
+	 * @brief Pull source over a span, handing out consecutive chunks of at most chunk_size elements.
+	 *
+	 * @tparam T The element type.
+	 * @param data The values.
+	 * @param chunk_size The maximum chunk length.
+	 * @return A callable source(chunk) that stores the next chunk and returns false when exhausted.
+	 */
+	template<typename T>
+	auto chunk_source(span<const T> data, size_t chunk_size)
+	{
+		if (chunk_size == 0) throw std::invalid_argument("Chunk size must be positive.");
+		return [data, chunk_size, offset = size_t(0)](span<const T>& chunk) mutable {
+			if (offset >= data.size()) return false;
+			chunk = data.subspan(offset, std::min(chunk_size, data.size() - offset));
+			offset += chunk.size();
+			return true;
+		};
+	}
+
+	/**
+	 * @brief Feed every chunk of a pull source into one or more accumulators.
+	 *
+	 * Each chunk is pushed into every accumulator before the next is requested,
+	 * so a source that starts reading chunk k + 1 before returning chunk k
+	 * overlaps its I/O with the aggregation on a single thread.
+	 *
+	 * @tparam T The element type.
+	 * @tparam Source Callable as bool(span<const T>&); returns false when exhausted.
+	 * @tparam Aggs Accumulator types providing push(const T*, size_t).
+	 * @param source The chunk source.
+	 * @param aggs The accumulators to update.
+	 * @return The number of values consumed.
+	 */
+	template<typename T, typename Source, typename... Aggs,
+		typename = std::enable_if_t<std::is_invocable_r_v<bool, Source&, span<const T>&>>>
+	size_t consume_chunks(Source&& source, Aggs&... aggs)
+	{
+		size_t consumed = 0;
+		span<const T> chunk;
+		while (source(chunk))
+		{
+			(aggs.push(chunk.data(), chunk.size()), ...);
+			consumed += chunk.size();
+		}
+		return consumed;
+	}
+
+#if BASIC_STATS_HAS_COROUTINES
+	/**
+	 * @brief Minimal synchronous generator coroutine, available when compiled as C++20.
+	 *
+	 * The coroutine runs until its next co_yield each time the iterator is
+	 * advanced; exceptions it throws are rethrown to the consumer.
+	 *
+	 * @tparam T The type of the yielded values.
+	 */
+	template<typename T>
+	class generator
+	{
+	public:
+		struct promise_type
+		{
+			const T* current = nullptr;
+			std::exception_ptr error;
+
+			generator get_return_object() { return generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_always final_suspend() noexcept { return {}; }
+			// The yielded object lives in the coroutine frame until it resumes.
+			std::suspend_always yield_value(const T& value) noexcept
+			{
+				current = std::addressof(value);
+				return {};
+			}
+			void return_void() {}
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		class iterator
+		{
+		public:
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() = default;
+
+			const T& operator*() const { return *handle_.promise().current; }
+
+			iterator& operator++()
+			{
+				advance(handle_);
+				return *this;
+			}
+
+			void operator++(int) { ++*this; }
+
+			bool operator==(std::default_sentinel_t) const { return !handle_ || handle_.done(); }
+
+		private:
+			friend class generator;
+
+			explicit iterator(std::coroutine_handle<promise_type> handle)
+				: handle_(handle)
+			{
+			}
+
+			std::coroutine_handle<promise_type> handle_;
+		};
+
+		generator(generator&& other) noexcept
+			: handle_(std::exchange(other.handle_, nullptr))
+		{
+		}
+
+		generator& operator=(generator&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (handle_) handle_.destroy();
+				handle_ = std::exchange(other.handle_, nullptr);
+			}
+			return *this;
+		}
+
+		~generator()
+		{
+			if (handle_) handle_.destroy();
+		}
+
+		iterator begin()
+		{
+			advance(handle_);
+			return iterator(handle_);
+		}
+
+		std::default_sentinel_t end() const noexcept { return {}; }
+
+	private:
+		explicit generator(std::coroutine_handle<promise_type> handle)
+			: handle_(handle)
+		{
+		}
+
+		static void advance(std::coroutine_handle<promise_type> handle)
+		{
+			handle.resume();
+			if (handle.promise().error) std::rethrow_exception(std::exchange(handle.promise().error, nullptr));
+		}
+
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	/**
+	 * @brief Generator over consecutive chunks of a span.
+	 *
+	 * @tparam T The element type.
+	 * @param data The values; must outlive the generator.
+	 * @param chunk_size The maximum chunk length.
+	 */
+	template<typename T>
+	generator<span<const T>> chunks_of(span<const T> data, size_t chunk_size)
+	{
+		if (chunk_size == 0) throw std::invalid_argument("Chunk size must be positive.");
+		for (size_t offset = 0; offset < data.size(); offset += chunk_size)
+			co_yield data.subspan(offset, std::min(chunk_size, data.size() - offset));
+	}
+
+	/**
+	 * @brief Wrap a C++17 pull source as a generator.
+	 *
+	 * @tparam T The element type.
+	 * @param source Callable as bool(span<const T>&); returns false when exhausted.
+	 */
+	template<typename T, typename Source>
+	generator<span<const T>> as_generator(Source source)
+	{
+		span<const T> chunk;
+		while (source(chunk)) co_yield chunk;
+	}
+
+	/**
+	 * @brief Drive one or more accumulators from a chunk generator.
+	 *
+	 * The generator is resumed for the next chunk only after the current one has
+	 * been pushed into every accumulator, so a producer that issues its next
+	 * asynchronous read before each co_yield overlaps I/O and computation
+	 * without any extra thread.
+	 *
+	 * @tparam T The element type.
+	 * @tparam Aggs Accumulator types providing push(const T*, size_t).
+	 * @param chunks The chunk generator.
+	 * @param aggs The accumulators to update.
+	 * @return The number of values consumed.
+	 */
+	template<typename T, typename... Aggs>
+	size_t consume_chunks(generator<span<const T>> chunks, Aggs&... aggs)
+	{
+		size_t consumed = 0;
+		for (const span<const T>& chunk : chunks)
+		{
+			(aggs.push(chunk.data(), chunk.size()), ...);
+			consumed += chunk.size();
+		}
+		return consumed;
+	}
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+	/**
+	 * @brief Tuning of a ChunkedFileReader.
+	 */
+	struct ChunkedReadOptions
+	{
+		size_t buffer_bytes = size_t(1) << 20;  // bytes per read; a multiple of 4096
+		size_t buffers = 4;                      // reads kept in flight, including the buffer being consumed
+		bool direct = true;                      // try O_DIRECT, falling back to buffered reads
+		bool use_io_uring = true;                // try io_uring, falling back to pread
+	};
+
+	/**
+	 * @brief The I/O path a ChunkedFileReader ended up using.
+	 */
+	enum class ReadBackend
+	{
+		io_uring,
+		pread
+	};
+
+#if BASIC_STATS_HAS_IO_URING
+	namespace detail
+	{
+		/**
+		 * @brief Minimal io_uring driven through the raw system calls, used only
+		 * for reads tagged with the index of their buffer.
+		 */
+		class IoUring
+		{
+		public:
+			explicit IoUring(unsigned int entries)
+			{
+				io_uring_params params;
+				std::memset(&params, 0, sizeof(params));
+				fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+				if (fd_ < 0) return;
+				if (!supports(IORING_OP_READ))
+				{
+					release();
+					return;
+				}
+				sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+				bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+				sq_ = ::mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+				cq_ = single ? sq_ : ::mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+				sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+				void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+				if (sq_ == MAP_FAILED || cq_ == MAP_FAILED || sqes == MAP_FAILED)
+				{
+					if (sqes != MAP_FAILED) ::munmap(sqes, sqes_size_);
+					release();
+					return;
+				}
+				unsigned char* sq = static_cast<unsigned char*>(sq_);
+				unsigned char* cq = static_cast<unsigned char*>(cq_);
+				sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+				sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+				sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+				cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+				cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+				cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+				cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+				sqes_ = static_cast<io_uring_sqe*>(sqes);
+			}
+
+			IoUring(const IoUring&) = delete;
+			IoUring& operator=(const IoUring&) = delete;
+
+			~IoUring() { release(); }
+
+			bool valid() const { return sqes_ != nullptr; }
+
+			/**
+			 * @brief Queue and submit a read of length bytes at offset into target.
+			 */
+			bool submit_read(int file, void* target, unsigned int length, uint64_t offset, uint64_t tag)
+			{
+				unsigned tail = *sq_tail_;
+				unsigned index = tail & sq_mask_;
+				io_uring_sqe& sqe = sqes_[index];
+				std::memset(&sqe, 0, sizeof(sqe));
+				sqe.opcode = IORING_OP_READ;
+				sqe.fd = file;
+				sqe.addr = reinterpret_cast<uint64_t>(target);
+				sqe.len = length;
+				sqe.off = offset;
+				sqe.user_data = tag;
+				sq_array_[index] = index;
+				__atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+				return enter(1, 0, 0) >= 0;
+			}
+
+			/**
+			 * @brief Wait for the next completion.
+			 *
+			 * @param tag Receives the tag of the completed read.
+			 * @return The read's result: bytes read, or a negative errno.
+			 */
+			int wait(uint64_t& tag)
+			{
+				while (true)
+				{
+					unsigned head = *cq_head_;
+					if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+					{
+						const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+						tag = cqe.user_data;
+						int result = cqe.res;
+						__atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+						return result;
+					}
+					if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) return -errno;
+				}
+			}
+
+		private:
+			/**
+			 * @brief Whether the kernel implements an opcode.
+			 *
+			 * Kernels 5.1 to 5.5 accept io_uring_setup but fail IORING_OP_READ
+			 * with -EINVAL; they also reject the probe, so they report false here.
+			 */
+			bool supports(unsigned int op) const
+			{
+				constexpr unsigned int max_ops = 256;
+				std::vector<unsigned char> storage(sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op), 0);
+				io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+				if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, max_ops) < 0) return false;
+				return op <= probe->last_op && op < probe->ops_len && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+			}
+
+			int enter(unsigned int submit, unsigned int wait, unsigned int flags)
+			{
+				return static_cast<int>(::syscall(__NR_io_uring_enter, fd_, submit, wait, flags, nullptr, 0));
+			}
+
+			void release()
+			{
+				if (sqes_) ::munmap(sqes_, sqes_size_);
+				if (cq_ && cq_ != MAP_FAILED && cq_ != sq_) ::munmap(cq_, cq_size_);
+				if (sq_ && sq_ != MAP_FAILED) ::munmap(sq_, sq_size_);
+				if (fd_ >= 0) ::close(fd_);
+				sqes_ = nullptr;
+				sq_ = cq_ = nullptr;
+				fd_ = -1;
+			}
+
+			int fd_ = -1;
+			void* sq_ = nullptr;
+			void* cq_ = nullptr;
+			size_t sq_size_ = 0;
+			size_t cq_size_ = 0;
+			size_t sqes_size_ = 0;
+			unsigned* sq_tail_ = nullptr;
+			unsigned sq_mask_ = 0;
+			unsigned* sq_array_ = nullptr;
+			unsigned* cq_head_ = nullptr;
+			unsigned* cq_tail_ = nullptr;
+			unsigned cq_mask_ = 0;
+			io_uring_cqe* cqes_ = nullptr;
+			io_uring_sqe* sqes_ = nullptr;
+		};
+	}
+#endif
+
+	/**
+	 * @brief Reads a binary file of packed T values in large aligned chunks.
+	 *
+	 * A pool of page-aligned buffers cycles through the file. With io_uring every
+	 * buffer not being consumed has a read in flight, so the caller's reduction
+	 * of one chunk overlaps the reads of the following ones. Without io_uring the
+	 * reader falls back to synchronous pread. O_DIRECT is used when the file
+	 * system accepts it, bypassing the page cache for cold data.
+	 *
+	 * The reader is a pull source for consume_chunks(): each call hands out the
+	 * next chunk, which stays valid until the following call.
+	 *
+	 * @tparam T The element type; must be trivially copyable.
+	 */
+	template<typename T>
+	class ChunkedFileReader
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "ChunkedFileReader elements must be trivially copyable.");
+
+	public:
+		/**
+		 * @brief Open a file.
+		 *
+		 * @param path The file, holding a whole number of T values.
+		 * @param options Buffer sizes and I/O paths to try.
+		 */
+		explicit ChunkedFileReader(const std::string& path, ChunkedReadOptions options = {})
+			: options_(options)
+		{
+			if (options_.buffer_bytes == 0 || options_.buffer_bytes % alignment != 0 || options_.buffer_bytes % sizeof(T) != 0
+				|| options_.buffer_bytes > std::numeric_limits<unsigned int>::max())
+				throw std::invalid_argument("Buffer size must be a multiple of 4096 and of the element size.");
+			options_.buffers = std::max<size_t>(options_.buffers, 1);
+#ifdef O_DIRECT
+			if (options_.direct) file_ = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+#endif
+			direct_ = file_ >= 0;
+			if (file_ < 0) file_ = ::open(path.c_str(), O_RDONLY);
+			if (file_ < 0) throw std::runtime_error("open failed for " + path + ".");
+			struct stat info;
+			if (::fstat(file_, &info) != 0)
+			{
+				::close(file_);
+				throw std::runtime_error("fstat failed for " + path + ".");
+			}
+			size_ = static_cast<uint64_t>(info.st_size);
+			if (size_ % sizeof(T) != 0)
+			{
+				::close(file_);
+				throw std::runtime_error(path + " does not hold a whole number of elements.");
+			}
+			try
+			{
+				for (size_t b = 0; b < options_.buffers; ++b)
+					buffers_.push_back(Buffer{ static_cast<unsigned char*>(::operator new(options_.buffer_bytes, std::align_val_t(alignment))), 0, 0 });
+#if BASIC_STATS_HAS_IO_URING
+				if (options_.use_io_uring)
+				{
+					ring_ = std::make_unique<detail::IoUring>(static_cast<unsigned int>(detail::next_power_of_two(options_.buffers)));
+					if (!ring_->valid()) ring_.reset();
+				}
+				if (ring_)
+				{
+					for (size_t b = 0; b < buffers_.size(); ++b) issue(b);
+				}
+#endif
+			}
+			catch (...)
+			{
+				release();
+				throw;
+			}
+		}
+
+		ChunkedFileReader(const ChunkedFileReader&) = delete;
+		ChunkedFileReader& operator=(const ChunkedFileReader&) = delete;
+
+		~ChunkedFileReader()
+		{
+			release();
+		}
+
+		/**
+		 * @brief Hand out the next chunk.
+		 *
+		 * @param chunk Receives the chunk, valid until the next call.
+		 * @return False once the whole file has been read.
+		 */
+		bool operator()(span<const T>& chunk)
+		{
+			return next(chunk);
+		}
+
+		/**
+		 * @brief Hand out the next chunk.
+		 *
+		 * @param chunk Receives the chunk, valid until the next call.
+		 * @return False once the whole file has been read.
+		 */
+		bool next(span<const T>& chunk)
+		{
+			if (delivered_ >= size_) return false;
+			Buffer& buffer = buffers_[current_];
+#if BASIC_STATS_HAS_IO_URING
+			if (ring_)
+			{
+				// The buffer handed out last time is free again.
+				if (has_previous_) issue(previous_);
+				while (!buffer.ready) complete_one();
+			}
+			else
+#endif
+			{
+				buffer.offset = delivered_;
+				buffer.length = read_fully(buffer.data, options_.buffer_bytes, std::min<uint64_t>(options_.buffer_bytes, size_ - delivered_), delivered_);
+			}
+			chunk = span<const T>(reinterpret_cast<const T*>(buffer.data), buffer.length / sizeof(T));
+			delivered_ += buffer.length;
+			buffer.ready = false;
+			previous_ = current_;
+			has_previous_ = true;
+			current_ = (current_ + 1) % buffers_.size();
+			return true;
+		}
+
+		uint64_t file_size() const { return size_; }
+		bool direct() const { return direct_; }
+
+		ReadBackend backend() const
+		{
+#if BASIC_STATS_HAS_IO_URING
+			if (ring_) return ReadBackend::io_uring;
+#endif
+			return ReadBackend::pread;
+		}
+
+	private:
+		static constexpr size_t alignment = 4096;
+
+		struct Buffer
+		{
+			unsigned char* data;
+			uint64_t offset;
+			size_t length;
+			bool ready = false;
+		};
+
+		void release()
+		{
+#if BASIC_STATS_HAS_IO_URING
+			// The kernel may still be writing into the buffers.
+			if (ring_)
+			{
+				uint64_t tag;
+				for (; in_flight_ > 0; --in_flight_) ring_->wait(tag);
+				ring_.reset();
+			}
+#endif
+			for (Buffer& buffer : buffers_) ::operator delete(buffer.data, std::align_val_t(alignment));
+			buffers_.clear();
+			if (file_ >= 0) ::close(file_);
+			file_ = -1;
+		}
+
+		// Reads length bytes, asking for up to capacity so that O_DIRECT reads
+		// of the file's tail stay a whole number of blocks.
+		size_t read_fully(unsigned char* target, size_t capacity, uint64_t length, uint64_t offset)
+		{
+			size_t done = 0;
+			while (done < length)
+			{
+				ssize_t n = ::pread(file_, target + done, capacity - done, static_cast<off_t>(offset + done));
+				if (n < 0 && errno == EINTR) continue;
+				if (n < 0) throw std::runtime_error("pread failed.");
+				if (n == 0) break;
+				done += static_cast<size_t>(n);
+			}
+			if (done < length) throw std::runtime_error("File ended before its expected size.");
+			return static_cast<size_t>(length);
+		}
+
+#if BASIC_STATS_HAS_IO_URING
+		void issue(size_t b)
+		{
+			if (next_offset_ >= size_) return;
+			Buffer& buffer = buffers_[b];
+			buffer.offset = next_offset_;
+			buffer.length = static_cast<size_t>(std::min<uint64_t>(options_.buffer_bytes, size_ - next_offset_));
+			buffer.ready = false;
+			next_offset_ += buffer.length;
+			if (!ring_->submit_read(file_, buffer.data, static_cast<unsigned int>(options_.buffer_bytes), buffer.offset, b))
+				throw std::runtime_error("io_uring submission failed.");
+			++in_flight_;
+		}
+
+		void complete_one()
+		{
+			uint64_t tag = 0;
+			int result = ring_->wait(tag);
+			--in_flight_;
+			if (result < 0) throw std::runtime_error("io_uring read failed: " + std::string(std::strerror(-result)) + ".");
+			Buffer& buffer = buffers_[static_cast<size_t>(tag)];
+			// Finish a short read synchronously; it only happens at interruptions.
+			if (static_cast<size_t>(result) < buffer.length)
+				read_fully(buffer.data + result, options_.buffer_bytes - result, buffer.length - result, buffer.offset + result);
+			buffer.ready = true;
+		}
+
+		std::unique_ptr<detail::IoUring> ring_;
+		size_t in_flight_ = 0;
+#endif
+
+		ChunkedReadOptions options_;
+		int file_ = -1;
+		bool direct_ = false;
+		uint64_t size_ = 0;
+		uint64_t next_offset_ = 0;
+		uint64_t delivered_ = 0;
+		std::vector<Buffer> buffers_;
+		size_t current_ = 0;
+		size_t previous_ = 0;
+		bool has_previous_ = false;
+	};
+
+	/**
+	 * @brief Aggregate a binary file of packed T values chunk by chunk.
+	 *
+	 * @tparam T The element type stored in the file.
+	 * @tparam Agg The accumulator type, providing push(const T*, size_t).
+	 * @param path The file.
+	 * @param prototype The initial accumulator.
+	 * @param options Buffer sizes and I/O paths to try.
+	 * @return The accumulator after every value of the file has been pushed.
+	 */
+	template<typename T, typename Agg = Moments>
+	Agg aggregate_file(const std::string& path, Agg prototype = Agg(), ChunkedReadOptions options = {})
+	{
+		ChunkedFileReader<T> reader(path, options);
+		consume_chunks<T>(reader, prototype);
+		return prototype;
+	}
+#endif
+
+	/**
+	 * @brief Summary stored in the header of every block of a column file or compressed series.
+	 *
+	 * The spread is kept as M2, the sum of squared deviations from the block
+	 * mean, which merges exactly through Moments, rather than as a raw sum of
+	 * squares that loses precision for data far from zero. NaN values are
+	 * included in count and also counted by nans, since they poison the other
+	 * fields; range queries must read such blocks value by value.
+	 */
+	struct ZoneMap
+	{
+		uint64_t count;
+		double min;
+		double max;
+		double sum;
+		double m2;
+		uint64_t nans;
+
+		/**
+		 * @brief Summarise a block of values.
+		 *
+		 * @param values Pointer to the first value.
+		 * @param n The number of values.
+		 */
+		template<typename T>
+		static ZoneMap of(const T* values, size_t n)
+		{
+			Moments m;
+			m.push(values, n);
+			uint64_t nans = 0;
+			if constexpr (std::is_floating_point_v<T>)
+			{
+				for (size_t i = 0; i < n; ++i) nans += values[i] != values[i];
+			}
+			return ZoneMap{ m.count(), m.min(), m.max(), m.sum(), m.m2(), nans };
+		}
+
+		/**
+		 * @brief The block summary as a Moments accumulator.
+		 */
+		Moments moments() const
+		{
+			return count == 0 ? Moments() : Moments(static_cast<size_t>(count), sum / count, m2, min, max);
+		}
+	};
+
+	/**
+	 * @brief How a range query over a column file treated its blocks.
+	 */
+	struct ZoneScan
+	{
+		size_t skipped = 0;      // entirely outside the range
+		size_t from_header = 0;  // entirely inside the range, answered from the zone map
+		size_t scanned = 0;      // straddling a bound, read value by value
+	};
+
+#if defined(__unix__) || defined(__APPLE__)
+
+	namespace detail
+	{
+		/**
+		 * @brief Fixed header at the start of a column file.
+		 */
+		struct ColumnFileHeader
+		{
+			static constexpr uint32_t magic_value = 0x46435342; // "BSCF"
+			static constexpr uint32_t current_version = 1;
+			static constexpr uint32_t byte_order_mark = 0x01020304;
+
+			uint32_t magic;
+			uint32_t version;
+			uint32_t byte_order;
+			uint32_t type_code;
+			uint64_t block_size;
+			uint64_t count;
+			uint64_t block_count;
+			uint64_t data_offset;
+		};
+
+		template<typename T>
+		constexpr uint32_t column_type_code()
+		{
+			static_assert(std::is_arithmetic_v<T>, "Column files hold arithmetic values.");
+			return (std::is_floating_point_v<T> ? 2u : std::is_signed_v<T> ? 1u : 0u) << 8 | static_cast<uint32_t>(sizeof(T));
+		}
+
+		inline uint64_t column_data_offset(uint64_t block_count)
+		{
+			uint64_t end = sizeof(ColumnFileHeader) + block_count * sizeof(ZoneMap);
+			return (end + 63) / 64 * 64;
+		}
+	}
+
+	/**
+	 * @brief Write values to a column file of fixed-size blocks, each described by a zone map.
+	 *
+	 * The file is sized up front and filled through a shared mapping, and the
+	 * zone maps of the blocks are computed in parallel. It is written under a
+	 * temporary name, synced and renamed over path, so a ColumnFile already
+	 * mapping the old file keeps reading it intact and a crash never leaves a
+	 * valid header over missing data.
+	 *
+	 * @tparam T The type of the values.
+	 * @param path The file to create or replace.
+	 * @param data The values.
+	 * @param block_size The number of values per block.
+	 */
+	template<typename T>
+	void write_column_file(const std::string& path, span<const T> data, size_t block_size = 4096)
+	{
+		if (block_size == 0) throw std::invalid_argument("Block size must be positive.");
+		uint64_t blocks = (data.size() + block_size - 1) / block_size;
+		uint64_t offset = detail::column_data_offset(blocks);
+		size_t size = static_cast<size_t>(offset + data.size() * sizeof(T));
+		std::string temporary = path + ".tmp." + std::to_string(::getpid());
+		int fd = ::open(temporary.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+		if (fd < 0) throw std::runtime_error("open failed for " + temporary + ".");
+		auto fail = [&](const char* what) {
+			::close(fd);
+			::unlink(temporary.c_str());
+			throw std::runtime_error(std::string(what) + " failed for " + temporary + ".");
+		};
+		if (::ftruncate(fd, static_cast<off_t>(size)) != 0) fail("ftruncate");
+		void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED) fail("mmap");
+		unsigned char* base = static_cast<unsigned char*>(address);
+
+		detail::ColumnFileHeader header{ detail::ColumnFileHeader::magic_value, detail::ColumnFileHeader::current_version,
+			detail::ColumnFileHeader::byte_order_mark, detail::column_type_code<T>(), block_size, data.size(), blocks, offset };
+		std::memcpy(base, &header, sizeof(header));
+		unsigned char* zones = base + sizeof(header);
+		T* values = reinterpret_cast<T*>(base + offset);
+		detail::parallel_for(static_cast<size_t>(blocks), std::max<size_t>(1, grain_size(ParallelAlgorithm::reduce) / block_size), [&](size_t b, size_t e) {
+			for (size_t k = b; k < e; ++k)
+			{
+				size_t first = k * block_size, length = std::min(block_size, data.size() - first);
+				std::memcpy(values + first, data.data() + first, length * sizeof(T));
+				ZoneMap zone = ZoneMap::of(data.data() + first, length);
+				std::memcpy(zones + k * sizeof(ZoneMap), &zone, sizeof(zone));
+			}
+		});
+		bool synced = ::msync(address, size, MS_SYNC) == 0;
+		::munmap(address, size);
+		if (!synced) fail("msync");
+		if (::fsync(fd) != 0) fail("fsync");
+		::close(fd);
+		if (::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			::unlink(temporary.c_str());
+			throw std::runtime_error("rename failed for " + path + ".");
+		}
+	}
+
+	/**
+	 * @brief Write values to a column file of fixed-size blocks, each described by a zone map.
+	 *
+	 * @tparam T The type of the values.
+	 * @param path The file to create or replace.
+	 * @param data The values.
+	 * @param block_size The number of values per block.
+	 */
+	template<typename T>
+	void write_column_file(const std::string& path, const std::vector<T>& data, size_t block_size = 4096)
+	{
+		write_column_file(path, span<const T>(data), block_size);
+	}
+
+	/**
+	 * @brief Read-only, memory-mapped view of a column file written by write_column_file().
+	 *
+	 * Blocks are handed out as spans into the mapping, so nothing is copied.
+	 * Range queries use the zone maps to skip blocks entirely outside the range
+	 * and to answer blocks entirely inside it without reading their values.
+	 *
+	 * @tparam T The type of the values; must match the type the file was written with.
+	 */
+	template<typename T>
+	class ColumnFile
+	{
+	public:
+		/**
+		 * @brief Map a column file.
+		 *
+		 * @param path The file.
+		 */
+		explicit ColumnFile(const std::string& path)
+		{
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) throw std::runtime_error("open failed for " + path + ".");
+			struct stat info;
+			if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(detail::ColumnFileHeader))
+			{
+				::close(fd);
+				throw std::runtime_error(path + " is not a column file.");
+			}
+			size_ = static_cast<size_t>(info.st_size);
+			void* address = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (address == MAP_FAILED) throw std::runtime_error("mmap failed for " + path + ".");
+			base_ = static_cast<const unsigned char*>(address);
+			std::memcpy(&header_, base_, sizeof(header_));
+			bool valid = header_.magic == detail::ColumnFileHeader::magic_value && header_.version == detail::ColumnFileHeader::current_version
+				&& header_.byte_order == detail::ColumnFileHeader::byte_order_mark && header_.block_size > 0
+				&& header_.block_count == (header_.count + header_.block_size - 1) / header_.block_size
+				&& header_.data_offset == detail::column_data_offset(header_.block_count)
+				&& header_.data_offset + header_.count * sizeof(T) <= size_;
+			if (!valid || header_.type_code != detail::column_type_code<T>())
+			{
+				::munmap(const_cast<unsigned char*>(base_), size_);
+				throw std::runtime_error(path + (valid ? " holds a different value type." : " is not a supported column file."));
+			}
+			zones_ = reinterpret_cast<const ZoneMap*>(base_ + sizeof(detail::ColumnFileHeader));
+			values_ = reinterpret_cast<const T*>(base_ + header_.data_offset);
+		}
+
+		ColumnFile(const ColumnFile&) = delete;
+		ColumnFile& operator=(const ColumnFile&) = delete;
+
+		~ColumnFile()
+		{
+			::munmap(const_cast<unsigned char*>(base_), size_);
+		}
+
+		size_t size() const { return static_cast<size_t>(header_.count); }
+		size_t block_size() const { return static_cast<size_t>(header_.block_size); }
+		size_t block_count() const { return static_cast<size_t>(header_.block_count); }
+
+		/**
+		 * @brief Every value of the file.
+		 */
+		span<const T> values() const { return span<const T>(values_, size()); }
+
+		/**
+		 * @brief The values of one block.
+		 *
+		 * @param b The block index.
+		 */
+		span<const T> block(size_t b) const
+		{
+			if (b >= block_count()) throw std::out_of_range("Block index out of range.");
+			size_t first = b * block_size();
+			return span<const T>(values_ + first, std::min(block_size(), size() - first));
+		}
+
+		/**
+		 * @brief The zone map of one block.
+		 *
+		 * @param b The block index.
+		 */
+		const ZoneMap& zone(size_t b) const
+		{
+			if (b >= block_count()) throw std::out_of_range("Block index out of range.");
+			return zones_[b];
+		}
+
+		/**
+		 * @brief Moments of the whole file, from the zone maps alone.
+		 */
+		Moments moments() const
+		{
+			return detail::tree_merge<Moments>(block_count(), grain_size(ParallelAlgorithm::merge),
+				[&](size_t b) { return zones_[b].moments(); });
+		}
+
+		/**
+		 * @brief Moments of the values in [lower, upper].
+		 *
+		 * @param lower The smallest value to include.
+		 * @param upper The largest value to include.
+		 * @param scan Receives how many blocks were skipped, answered from their
+		 * zone map, or scanned.
+		 * @return The moments of the matching values.
+		 */
+		Moments filter_moments(double lower, double upper, ZoneScan* scan = nullptr) const
+		{
+			enum Kind : unsigned char { skip, header, read };
+			size_t blocks = block_count();
+			std::vector<unsigned char> kinds(blocks);
+			ZoneScan counts;
+			for (size_t k = 0; k < blocks; ++k)
+			{
+				const ZoneMap& zone = zones_[k];
+				// NaN makes the bounds and sum of a zone map unreliable, and the scan drops it.
+				kinds[k] = zone.nans != 0 ? read : zone.max < lower || zone.min > upper ? skip : zone.min >= lower && zone.max <= upper ? header : read;
+				if (kinds[k] == skip) ++counts.skipped;
+				else if (kinds[k] == header) ++counts.from_header;
+				else ++counts.scanned;
+			}
+			if (scan) *scan = counts;
+			return detail::tree_merge<Moments>(blocks, std::max<size_t>(1, grain_size(ParallelAlgorithm::reduce) / block_size()),
+				[&](size_t k) {
+					if (kinds[k] == header) return zones_[k].moments();
+					Moments m;
+					if (kinds[k] == skip) return m;
+					for (const T& value : block(k))
+					{
+						double x = static_cast<double>(value);
+						if (x >= lower && x <= upper) m.push(x);
+					}
+					return m;
+				});
+		}
+
+	private:
+		const unsigned char* base_ = nullptr;
+		size_t size_ = 0;
+		detail::ColumnFileHeader header_;
+		const ZoneMap* zones_ = nullptr;
+		const T* values_ = nullptr;
+	};
+#endif
+
+	namespace detail
+	{
+		/**
+		 * @brief Count the leading zero bits of a non-zero 64-bit word.
+		 */
+		inline unsigned int clz64(uint64_t x)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return static_cast<unsigned int>(__builtin_clzll(x));
+#else
+			unsigned int n = 0;
+			while ((x & (uint64_t(1) << 63)) == 0)
+			{
+				x <<= 1;
+				++n;
+			}
+			return n;
+#endif
+		}
+
+		/**
+		 * @brief Appends bit fields, most significant bit first, to a word vector.
+		 */
+		class BitWriter
+		{
+		public:
+			explicit BitWriter(std::vector<uint64_t>& words)
+				: words_(words)
+			{
+			}
+
+			/**
+			 * @brief Append the low bits (1 to 64) of value.
+			 */
+			void write(uint64_t value, unsigned int bits)
+			{
+				if (bits < 64) value &= (uint64_t(1) << bits) - 1;
+				if (used_ == 64)
+				{
+					words_.push_back(0);
+					used_ = 0;
+				}
+				unsigned int space = 64 - used_;
+				if (bits <= space)
+				{
+					words_.back() |= value << (space - bits);
+					used_ += bits;
+					return;
+				}
+				words_.back() |= value >> (bits - space);
+				used_ = bits - space;
+				words_.push_back(value << (64 - used_));
+			}
+
+		private:
+			std::vector<uint64_t>& words_;
+			unsigned int used_ = 64;
+		};
+
+		/**
+		 * @brief Reads bit fields written by BitWriter.
+		 */
+		class BitReader
+		{
+		public:
+			explicit BitReader(const uint64_t* words)
+				: words_(words)
+			{
+			}
+
+			/**
+			 * @brief Read a field of 1 to 64 bits.
+			 */
+			uint64_t read(unsigned int bits)
+			{
+				size_t word = position_ >> 6;
+				unsigned int offset = static_cast<unsigned int>(position_ & 63);
+				position_ += bits;
+				uint64_t value = words_[word] << offset;
+				if (offset + bits > 64) value |= words_[word + 1] >> (64 - offset);
+				return value >> (64 - bits);
+			}
+
+			bool bit() { return read(1) != 0; }
+
+		private:
+			const uint64_t* words_;
+			size_t position_ = 0;
+		};
+
+		/**
+		 * @brief Gorilla XOR encoding of doubles: each value is XORed with its
+		 * predecessor and only the meaningful bits of the result are stored,
+		 * reusing the previous leading and trailing zero window when it fits.
+		 */
+		inline void encode_xor(const double* values, size_t n, BitWriter& out)
+		{
+			uint64_t previous;
+			std::memcpy(&previous, values, sizeof(previous));
+			out.write(previous, 64);
+			unsigned int leading = 65, trailing = 0;
+			for (size_t i = 1; i < n; ++i)
+			{
+				uint64_t bits;
+				std::memcpy(&bits, values + i, sizeof(bits));
+				uint64_t x = bits ^ previous;
+				previous = bits;
+				if (x == 0)
+				{
+					out.write(0, 1);
+					continue;
+				}
+				unsigned int lz = std::min(clz64(x), 31u), tz = ctz64(x);
+				if (leading <= 64 && lz >= leading && tz >= trailing)
+				{
+					out.write(0b10, 2);
+					out.write(x >> trailing, 64 - leading - trailing);
+					continue;
+				}
+				leading = lz;
+				trailing = tz;
+				unsigned int meaningful = 64 - lz - tz;
+				out.write(0b11, 2);
+				out.write(lz, 5);
+				out.write(meaningful - 1, 6);
+				out.write(x >> tz, meaningful);
+			}
+		}
+
+		inline void decode_xor(BitReader& in, size_t n, double* out)
+		{
+			uint64_t previous = in.read(64);
+			std::memcpy(out, &previous, sizeof(previous));
+			unsigned int leading = 0, trailing = 0;
+			for (size_t i = 1; i < n; ++i)
+			{
+				if (in.bit())
+				{
+					if (in.bit())
+					{
+						leading = static_cast<unsigned int>(in.read(5));
+						unsigned int meaningful = static_cast<unsigned int>(in.read(6)) + 1;
+						trailing = 64 - leading - meaningful;
+					}
+					previous ^= in.read(64 - leading - trailing) << trailing;
+				}
+				std::memcpy(out + i, &previous, sizeof(previous));
+			}
+		}
+
+		/**
+		 * @brief Delta-of-delta encoding of integers: the change between
+		 * consecutive deltas is zigzag coded into a 1, 9, 12, 16 or 68 bit field.
+		 * Arithmetic wraps modulo 2^64, so every 64-bit value round-trips.
+		 */
+		template<typename T>
+		void encode_delta_of_delta(const T* values, size_t n, BitWriter& out)
+		{
+			uint64_t previous = static_cast<uint64_t>(values[0]);
+			uint64_t previous_delta = 0;
+			out.write(previous, 64);
+			for (size_t i = 1; i < n; ++i)
+			{
+				uint64_t value = static_cast<uint64_t>(values[i]);
+				uint64_t delta = value - previous;
+				uint64_t dod = delta - previous_delta;
+				previous = value;
+				previous_delta = delta;
+				uint64_t zigzag = (dod << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(dod) >> 63);
+				if (zigzag == 0)
+					out.write(0, 1);
+				else if (zigzag < (uint64_t(1) << 7))
+					out.write((uint64_t(0b10) << 7) | zigzag, 9);
+				else if (zigzag < (uint64_t(1) << 9))
+					out.write((uint64_t(0b110) << 9) | zigzag, 12);
+				else if (zigzag < (uint64_t(1) << 12))
+					out.write((uint64_t(0b1110) << 12) | zigzag, 16);
+				else
+				{
+					out.write(0b1111, 4);
+					out.write(zigzag, 64);
+				}
+			}
+		}
+
+		template<typename T>
+		void decode_delta_of_delta(BitReader& in, size_t n, T* out)
+		{
+			uint64_t previous = in.read(64);
+			uint64_t delta = 0;
+			out[0] = static_cast<T>(previous);
+			for (size_t i = 1; i < n; ++i)
+			{
+				uint64_t zigzag = 0;
+				if (in.bit())
+				{
+					if (!in.bit()) zigzag = in.read(7);
+					else if (!in.bit()) zigzag = in.read(9);
+					else if (!in.bit()) zigzag = in.read(12);
+					else zigzag = in.read(64);
+				}
+				delta += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+				previous += delta;
+				out[i] = static_cast<T>(previous);
+			}
+		}
+	}
+
+	/**
+	 * @brief Append-only sample store kept in compressed, independently decodable blocks.
+	 *
+	 * Doubles use Gorilla XOR encoding and integers delta-of-delta encoding.
+	 * Every sealed block carries a ZoneMap, so count, min, max, sum and moments
+	 * are answered without decoding. Scans decode one block at a time into a
+	 * cache-sized buffer and hand it straight to the accumulator. Values are
+	 * appended to an uncompressed tail that is sealed once it fills a block.
+	 *
+	 * @tparam T double, float or an integral type.
+	 */
+	template<typename T>
+	class CompressedSamples
+	{
+		static_assert(std::is_floating_point_v<T> || std::is_integral_v<T>, "CompressedSamples holds floating-point or integral values.");
+
+		// float widens to double losslessly, so it shares the XOR codec.
+		using Stored = std::conditional_t<std::is_floating_point_v<T>, double, T>;
+
+	public:
+		/**
+		 * @brief Construct an empty store.
+		 *
+		 * @param block_size The number of values per block; 1024 doubles decode into 8 KiB.
+		 */
+		explicit CompressedSamples(size_t block_size = 1024)
+			: block_size_(block_size)
+		{
+			if (block_size_ == 0) throw std::invalid_argument("Block size must be positive.");
+			tail_.reserve(block_size_);
+		}
+
+		/**
+		 * @brief Append a single value.
+		 *
+		 * @param value The value to append.
+		 */
+		void push(T value)
+		{
+			tail_.push_back(static_cast<Stored>(value));
+			if (tail_.size() == block_size_) seal();
+		}
+
+		/**
+		 * @brief Append a contiguous batch of values.
+		 *
+		 * @param data Pointer to the first value.
+		 * @param n The number of values.
+		 */
+		void push(const T* data, size_t n)
+		{
+			for (size_t i = 0; i < n; ++i) push(data[i]);
+		}
+
+		size_t size() const { return sealed_count_ + tail_.size(); }
+		size_t block_size() const { return block_size_; }
+
+		/**
+		 * @brief The number of blocks, counting a partly filled tail as one.
+		 */
+		size_t block_count() const { return blocks_.size() + (tail_.empty() ? 0 : 1); }
+
+		/**
+		 * @brief The approximate memory held, in bytes.
+		 */
+		size_t bytes() const
+		{
+			return words_.size() * sizeof(uint64_t) + blocks_.size() * sizeof(Block) + tail_.capacity() * sizeof(Stored);
+		}
+
+		/**
+		 * @brief The zone map of a block, read without decoding.
+		 *
+		 * @param b The block index.
+		 */
+		ZoneMap zone(size_t b) const
+		{
+			if (b >= block_count()) throw std::out_of_range("Block index out of range.");
+			if (b < blocks_.size()) return blocks_[b].zone;
+			return summarize(tail_.data(), tail_.size());
+		}
+
+		/**
+		 * @brief Moments of every value, from the zone maps alone.
+		 */
+		Moments moments() const
+		{
+			return detail::tree_merge<Moments>(block_count(), grain_size(ParallelAlgorithm::merge), [&](size_t b) { return zone(b).moments(); });
+		}
+
+		/**
+		 * @brief Decode one block.
+		 *
+		 * @param b The block index.
+		 * @param out Receives the values; must have room for block_size() values.
+		 * @return The number of values written.
+		 */
+		size_t decode(size_t b, T* out) const
+		{
+			if (b >= block_count()) throw std::out_of_range("Block index out of range.");
+			if (b == blocks_.size())
+			{
+				std::transform(tail_.begin(), tail_.end(), out, [](Stored v) { return static_cast<T>(v); });
+				return tail_.size();
+			}
+			const Block& block = blocks_[b];
+			size_t n = static_cast<size_t>(block.zone.count);
+			detail::BitReader in(words_.data() + block.word_offset);
+			if constexpr (std::is_floating_point_v<T>)
+			{
+				if constexpr (std::is_same_v<T, double>)
+				{
+					detail::decode_xor(in, n, out);
+				}
+				else
+				{
+					std::vector<double> wide(n);
+					detail::decode_xor(in, n, wide.data());
+					std::transform(wide.begin(), wide.end(), out, [](double v) { return static_cast<T>(v); });
+				}
+			}
+			else
+			{
+				detail::decode_delta_of_delta(in, n, out);
+			}
+			return n;
+		}
+
+		/**
+		 * @brief Decode the blocks one at a time into a reusable buffer.
+		 *
+		 * @param fn Called as fn(const T* values, size_t n) for every block in order.
+		 */
+		template<typename Function>
+		void for_each_block(Function fn) const
+		{
+			std::vector<T> buffer(block_size_);
+			for (size_t b = 0; b < block_count(); ++b)
+			{
+				size_t n = decode(b, buffer.data());
+				fn(static_cast<const T*>(buffer.data()), n);
+			}
+		}
+
+		/**
+		 * @brief Aggregate every value, decoding blocks in parallel on the default executor.
+		 *
+		 * @tparam Agg The accumulator type, providing push(const T*, size_t) and merge().
+		 * @param prototype An empty accumulator copied for every task.
+		 * @return The merged accumulator.
+		 */
+		template<typename Agg = Moments>
+		Agg aggregate(Agg prototype = Agg()) const
+		{
+			size_t blocks = block_count();
+			return detail::tree_merge<Agg>(blocks, std::max<size_t>(1, grain_size(ParallelAlgorithm::reduce) / block_size_), [&](size_t b) {
+				std::vector<T> buffer(block_size_);
+				Agg agg = prototype;
+				agg.push(buffer.data(), decode(b, buffer.data()));
+				return agg;
+			});
+		}
+
+		/**
+		 * @brief Decode every value.
+		 */
+		std::vector<T> to_vector() const
+		{
+			std::vector<T> result(blocks_.size() * block_size_ + block_size_);
+			size_t n = 0;
+			for (size_t b = 0; b < block_count(); ++b) n += decode(b, result.data() + n);
+			result.resize(n);
+			return result;
+		}
+
+		/**
+		 * @brief Calculate a percentile of the stored values.
+		 *
+		 * Blocks whose zone map lies wholly below or above the requested rank's
+		 * candidates are not decoded. NaN values have no rank and are left out.
+		 *
+		 * @param p The percentile to calculate (0-100).
+		 * @return The value at the specified percentile, or 0 if no value other than NaN is stored.
+		 */
+		double percentile(double p) const
+		{
+			if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+			size_t nans = 0;
+			for (size_t b = 0; b < block_count(); ++b) nans += static_cast<size_t>(zone(b).nans);
+			size_t ranked = size() - nans;
+			if (ranked == 0) return 0.0;
+			double rank = (p / 100) * (ranked - 1);
+			size_t lo = static_cast<size_t>(std::floor(rank)), hi = static_cast<size_t>(std::ceil(rank));
+			double low = nth(lo), high = hi == lo ? low : nth(hi);
+			return low + (rank - lo) * (high - low);
+		}
+
+	private:
+		struct Block
+		{
+			size_t word_offset;
+			ZoneMap zone;
+		};
+
+		static ZoneMap summarize(const Stored* values, size_t n)
+		{
+			return ZoneMap::of(values, n);
+		}
+
+		void seal()
+		{
+			Block block{ words_.size(), summarize(tail_.data(), tail_.size()) };
+			detail::BitWriter out(words_);
+			if constexpr (std::is_floating_point_v<T>)
+				detail::encode_xor(tail_.data(), tail_.size(), out);
+			else
+				detail::encode_delta_of_delta(tail_.data(), tail_.size(), out);
+			// Pad so the reader's two-word window never leaves the vector.
+			words_.push_back(0);
+			blocks_.push_back(block);
+			sealed_count_ += tail_.size();
+			tail_.clear();
+		}
+
+		// The k-th smallest value other than NaN. The zone maps bound it to
+		// [low, high]: at least k + 1 values lie in blocks starting at or below
+		// low, and at least k + 1 in blocks ending at or below high. Blocks wholly
+		// below low only add to the count beneath the window and blocks wholly
+		// above high are ignored; only the rest are decoded. A block whose bound
+		// is NaN is taken to span every value, so it is always decoded.
+		double nth(size_t k) const
+		{
+			size_t blocks = block_count();
+			std::vector<ZoneMap> zones(blocks);
+			for (size_t b = 0; b < blocks; ++b)
+			{
+				zones[b] = zone(b);
+				if (zones[b].min != zones[b].min) zones[b].min = -std::numeric_limits<double>::infinity();
+				if (zones[b].max != zones[b].max) zones[b].max = std::numeric_limits<double>::infinity();
+			}
+			auto bound = [&](auto key) {
+				std::vector<std::pair<double, uint64_t>> order;
+				for (const ZoneMap& z : zones) order.emplace_back(key(z), z.count - z.nans);
+				std::sort(order.begin(), order.end());
+				uint64_t cumulative = 0;
+				for (const std::pair<double, uint64_t>& entry : order)
+				{
+					cumulative += entry.second;
+					if (cumulative > k) return entry.first;
+				}
+				return order.back().first;
+			};
+			double low = bound([](const ZoneMap& z) { return z.min; });
+			double high = bound([](const ZoneMap& z) { return z.max; });
+
+			size_t below = 0;
+			std::vector<double> window;
+			std::vector<T> buffer(block_size_);
+			for (size_t b = 0; b < blocks; ++b)
+			{
+				if (zones[b].max < low)
+				{
+					below += static_cast<size_t>(zones[b].count - zones[b].nans);
+					continue;
+				}
+				if (zones[b].min > high) continue;
+				size_t n = decode(b, buffer.data());
+				for (size_t i = 0; i < n; ++i)
+				{
+					double x = static_cast<double>(buffer[i]);
+					if (x != x) continue;
+					if (x < low) ++below;
+					else if (x <= high) window.push_back(x);
+				}
+			}
+			std::nth_element(window.begin(), window.begin() + (k - below), window.end());
+			return window[k - below];
+		}
+
+		size_t block_size_;
+		std::vector<uint64_t> words_;
+		std::vector<Block> blocks_;
+		std::vector<Stored> tail_;
+		size_t sealed_count_ = 0;
+	};
+
+	/**
+	 * @brief How a reduction treats NaN values.
+	 *
+	 * Integral inputs never hold NaN, so the policy only matters for
+	 * floating-point data.
+	 */
+	enum class NanPolicy
+	{
+		propagate,  // any NaN makes the result NaN
+		skip,       // NaN values are treated as missing
+		error       // any NaN throws std::invalid_argument
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief Moments, exact sum and NaN count of the values kept by a mask.
+		 */
+		struct MaskedSummary
+		{
+			Moments moments;
+			double sum = 0.0;
+			size_t nans = 0;
+		};
+
+		/**
+		 * @brief Read bit i of an Arrow-style validity bitmap (least significant bit first).
+		 */
+		inline bool validity_bit(const uint8_t* validity, size_t i)
+		{
+			return (validity[i >> 3] >> (i & 7)) & 1;
+		}
+
+		template<typename T>
+		bool is_nan_value(T value)
+		{
+			if constexpr (std::is_floating_point_v<T>) return value != value;
+			else return false;
+		}
+
+		/**
+		 * @brief Reduce the values that are valid and not NaN.
+		 *
+		 * Missing and NaN entries are masked out with selects rather than branches
+		 * so the block loops vectorise like Moments::push: a masked value adds zero
+		 * to the sums and the identity to the minimum and maximum. Blocks are
+		 * combined with Chan's formula.
+		 *
+		 * @param data Pointer to the first value.
+		 * @param validity Arrow-style validity bitmap, or nullptr when every value is present.
+		 * @param n The number of values.
+		 * @param stop_at_nan Return as soon as a block containing a NaN has been seen.
+		 */
+		template<typename T>
+		MaskedSummary masked_summary(const T* data, const uint8_t* validity, size_t n, bool stop_at_nan)
+		{
+			constexpr size_t block = 1024;
+			constexpr double inf = std::numeric_limits<double>::infinity();
+			MaskedSummary summary;
+			unsigned char keep[block];
+			for (size_t begin = 0; begin < n; begin += block)
+			{
+				size_t len = std::min(block, n - begin);
+				const T* p = data + begin;
+				if (validity)
+				{
+					// begin is a multiple of 8, so whole bitmap bytes expand to eight flags each.
+					const uint8_t* bits = validity + begin / 8;
+					size_t whole = len / 8;
+					for (size_t j = 0; j < whole; ++j)
+						for (size_t k = 0; k < 8; ++k) keep[8 * j + k] = (bits[j] >> k) & 1;
+					for (size_t i = 8 * whole; i < len; ++i) keep[i] = validity_bit(validity, begin + i);
+				}
+				else
+				{
+					std::memset(keep, 1, len);
+				}
+				size_t kept = 0, nans = 0;
+				double s = 0.0, lo = inf, hi = -inf;
+				for (size_t i = 0; i < len; ++i)
+				{
+					double x = static_cast<double>(p[i]);
+					unsigned char nan = is_nan_value(p[i]);
+					nans += keep[i] & nan;
+					keep[i] &= nan ^ 1;
+					kept += keep[i];
+					s += keep[i] ? x : 0.0;
+					lo = std::min(lo, keep[i] ? x : inf);
+					hi = std::max(hi, keep[i] ? x : -inf);
+				}
+				summary.nans += nans;
+				if (nans != 0 && stop_at_nan) return summary;
+				if (kept == 0) continue;
+				double m = s / kept;
+				double m2 = 0.0;
+				for (size_t i = 0; i < len; ++i)
+				{
+					double d = keep[i] ? static_cast<double>(p[i]) - m : 0.0;
+					m2 += d * d;
+				}
+				summary.sum += s;
+				summary.moments.merge(Moments(kept, m, m2, lo, hi));
+			}
+			return summary;
+		}
+
+		/**
+		 * @brief Apply a NaN policy to a masked reduction.
+		 *
+		 * @return The summary, or false when a NaN propagates to the result.
+		 */
+		template<typename T>
+		bool policy_summary(const T* data, const uint8_t* validity, size_t n, NanPolicy policy, MaskedSummary& summary)
+		{
+			summary = masked_summary(data, validity, n, policy != NanPolicy::skip);
+			if (summary.nans == 0 || policy == NanPolicy::skip) return true;
+			if (policy == NanPolicy::error) throw std::invalid_argument("Input contains NaN.");
+			return false;
+		}
+
+		/**
+		 * @brief Copy the values that are valid and not NaN, in their original order.
+		 *
+		 * The copy is compacted without branches: every value is written and the
+		 * output position only advances past kept ones.
+		 *
+		 * @return False when a NaN propagates to the result.
+		 */
+		template<typename T>
+		bool policy_kept(const T* data, const uint8_t* validity, size_t n, NanPolicy policy, std::vector<T>& out)
+		{
+			out.resize(n);
+			size_t kept = 0, nans = 0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				bool valid = !validity || validity_bit(validity, i);
+				bool nan = is_nan_value(data[i]);
+				nans += valid & nan;
+				out[kept] = data[i];
+				kept += valid & !nan;
+			}
+			out.resize(kept);
+			if (nans != 0 && policy == NanPolicy::error) throw std::invalid_argument("Input contains NaN.");
+			return nans == 0 || policy != NanPolicy::propagate;
+		}
+
+		/**
+		 * @brief Copy the values that are valid and not NaN, sorted, for the order statistics.
+		 *
+		 * @return False when a NaN propagates to the result.
+		 */
+		template<typename T>
+		bool policy_sorted(const T* data, const uint8_t* validity, size_t n, NanPolicy policy, std::vector<T>& out)
+		{
+			if (!policy_kept(data, validity, n, policy, out)) return false;
+			if (!detail::is_sorted(out.begin(), out.end())) parallel_sort(out.begin(), out.end());
+			return true;
+		}
+
+		template<typename T>
+		double kept_geo_mean(const std::vector<T>& kept)
+		{
+			if (kept.empty()) return 0.0;
+			double product = std::accumulate(kept.begin(), kept.end(), 1.0, std::multiplies<double>());
+			return std::pow(product, 1.0 / kept.size());
+		}
+
+		inline double summary_coeff_of_variation(const MaskedSummary& summary)
+		{
+			if (summary.moments.count() == 0) return 0.0;
+			return summary.moments.stdev() / (summary.sum / summary.moments.count());
+		}
+
+		inline void check_validity(size_t values, span<const uint8_t> validity)
+		{
+			if (validity.size() * 8 < values) throw std::invalid_argument("Validity bitmap is shorter than the data.");
+		}
+	}
+
+	/**
+	 * @brief Calculate the sum of a vector of numbers under a NaN policy.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The sum of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double sum(const std::vector<T>& data, NanPolicy policy)
+	{
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), nullptr, data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return summary.sum;
+	}
+
+	/**
+	 * @brief Calculate the sum of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The sum of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double sum(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), validity.data(), data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return summary.sum;
+	}
+
+	/**
+	 * @brief Calculate the arithmetic mean of a vector of numbers under a NaN policy.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The mean of the kept elements, 0 if none are kept, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double mean(const std::vector<T>& data, NanPolicy policy)
+	{
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), nullptr, data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return summary.moments.count() == 0 ? 0.0 : summary.sum / summary.moments.count();
+	}
+
+	/**
+	 * @brief Calculate the arithmetic mean of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The mean of the kept elements, 0 if none are kept, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double mean(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), validity.data(), data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return summary.moments.count() == 0 ? 0.0 : summary.sum / summary.moments.count();
+	}
+
+	/**
+	 * @brief Calculate the variance of a vector of numbers under a NaN policy.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The variance of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double variance(const std::vector<T>& data, NanPolicy policy)
+	{
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), nullptr, data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return summary.moments.variance();
+	}
+
+	/**
+	 * @brief Calculate the variance of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The variance of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double variance(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), validity.data(), data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return summary.moments.variance();
+	}
+
+	/**
+	 * @brief Calculate the standard deviation of a vector of numbers under a NaN policy.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The standard deviation of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double stdev(const std::vector<T>& data, NanPolicy policy)
+	{
+		return std::sqrt(variance(data, policy));
+	}
+
+	/**
+	 * @brief Calculate the standard deviation of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The standard deviation of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double stdev(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		return std::sqrt(variance(data, validity, policy));
+	}
+
+	/**
+	 * @brief Calculate the percentile of a vector of numbers under a NaN policy.
+	 *
+	 * Unlike the plain overload, NaN values never reach the sort.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param p The percentile to calculate (0-100).
+	 * @param policy How NaN values are treated.
+	 * @return The value at the specified percentile of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double percentile(const std::vector<T>& data, double p, NanPolicy policy)
+	{
+		if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), nullptr, data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::sorted_percentile(sorted_data.begin(), sorted_data.end(), p);
+	}
+
+	/**
+	 * @brief Calculate the percentile of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param p The percentile to calculate (0-100).
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The value at the specified percentile of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double percentile(const std::vector<T>& data, span<const uint8_t> validity, double p, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), validity.data(), data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::sorted_percentile(sorted_data.begin(), sorted_data.end(), p);
+	}
+
+	/**
+	 * @brief Calculate the median of a vector of numbers under a NaN policy.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The median of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double median(const std::vector<T>& data, NanPolicy policy)
+	{
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), nullptr, data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return sorted_data.empty() ? 0.0 : detail::sorted_median(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the median of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The median of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double median(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), validity.data(), data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return sorted_data.empty() ? 0.0 : detail::sorted_median(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the range of a vector of numbers under a NaN policy.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The range of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double range(const std::vector<T>& data, NanPolicy policy)
+	{
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), nullptr, data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return summary.moments.range();
+	}
+
+	/**
+	 * @brief Calculate the range of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The range of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double range(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), validity.data(), data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return summary.moments.range();
+	}
+
+	/**
+	 * @brief Calculate the geometric mean of a vector of numbers under a NaN policy.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The geometric mean of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double geo_mean(const std::vector<T>& data, NanPolicy policy)
+	{
+		std::vector<T> kept;
+		if (!detail::policy_kept(data.data(), nullptr, data.size(), policy, kept)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::kept_geo_mean(kept);
+	}
+
+	/**
+	 * @brief Calculate the geometric mean of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The geometric mean of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double geo_mean(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		std::vector<T> kept;
+		if (!detail::policy_kept(data.data(), validity.data(), data.size(), policy, kept)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::kept_geo_mean(kept);
+	}
+
+	/**
+	 * @brief Calculate the coefficient of variation of a vector of numbers under a NaN policy.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The coefficient of variation of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double coeff_of_variation(const std::vector<T>& data, NanPolicy policy)
+	{
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), nullptr, data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::summary_coeff_of_variation(summary);
+	}
+
+	/**
+	 * @brief Calculate the coefficient of variation of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The coefficient of variation of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double coeff_of_variation(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		detail::MaskedSummary summary;
+		if (!detail::policy_summary(data.data(), validity.data(), data.size(), policy, summary)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::summary_coeff_of_variation(summary);
+	}
+
+	/**
+	 * @brief Calculate the first quartile (Q1) of a vector of numbers under a NaN policy.
+	 *
+	 * Unlike the plain overload, NaN values never reach the sort.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The first quartile (Q1) of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double first_quartile(const std::vector<T>& data, NanPolicy policy)
+	{
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), nullptr, data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::sorted_first_quartile(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the first quartile (Q1) of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The first quartile (Q1) of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double first_quartile(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), validity.data(), data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::sorted_first_quartile(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the third quartile (Q3) of a vector of numbers under a NaN policy.
+	 *
+	 * Unlike the plain overload, NaN values never reach the sort.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The third quartile (Q3) of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double third_quartile(const std::vector<T>& data, NanPolicy policy)
+	{
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), nullptr, data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::sorted_third_quartile(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the third quartile (Q3) of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The third quartile (Q3) of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double third_quartile(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), validity.data(), data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::sorted_third_quartile(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the interquartile range (IQR) of a vector of numbers under a NaN policy.
+	 *
+	 * Unlike the plain overload, NaN values never reach the sort.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param policy How NaN values are treated.
+	 * @return The interquartile range (IQR) of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double iqr(const std::vector<T>& data, NanPolicy policy)
+	{
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), nullptr, data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::sorted_third_quartile(sorted_data.begin(), sorted_data.end()) - detail::sorted_first_quartile(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Calculate the interquartile range (IQR) of the valid entries of a vector of numbers.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of numbers.
+	 * @param validity Arrow-style validity bitmap; bit i (least significant first) is set when data[i] is present.
+	 * @param policy How NaN values among the valid entries are treated.
+	 * @return The interquartile range (IQR) of the kept elements, or NaN if a NaN propagates.
+	 */
+	template<typename T>
+	double iqr(const std::vector<T>& data, span<const uint8_t> validity, NanPolicy policy = NanPolicy::propagate)
+	{
+		detail::check_validity(data.size(), validity);
+		std::vector<T> sorted_data;
+		if (!detail::policy_sorted(data.data(), validity.data(), data.size(), policy, sorted_data)) return std::numeric_limits<double>::quiet_NaN();
+		return detail::sorted_third_quartile(sorted_data.begin(), sorted_data.end()) - detail::sorted_first_quartile(sorted_data.begin(), sorted_data.end());
+	}
+
+	/**
+	 * @brief Non-owning view of elements spaced a fixed number of bytes apart.
+	 *
+	 * A view over one field of an array of records lets the statistics run on
+	 * that field in place, without copying it into a vector first.
+	 *
+	 * @tparam T The element type; use a const type for read-only views.
+	 */
+	template<typename T>
+	class strided_span
+	{
+		using byte_type = std::conditional_t<std::is_const_v<T>, const unsigned char, unsigned char>;
+
+	public:
+		using element_type = T;
+		using value_type = std::remove_cv_t<T>;
+
+		constexpr strided_span() noexcept = default;
+
+		/**
+		 * @brief View size elements starting at data, stride bytes apart.
+		 *
+		 * @param data Pointer to the first element.
+		 * @param size The number of elements.
+		 * @param stride The distance between consecutive elements, in bytes.
+		 */
+		strided_span(T* data, size_t size, size_t stride = sizeof(T))
+			: data_(reinterpret_cast<byte_type*>(data)), size_(size), stride_(stride)
+		{
+			if (stride_ == 0 || stride_ % alignof(T) != 0) throw std::invalid_argument("Stride must be a positive multiple of the element alignment.");
+		}
+
+		strided_span(span<T> values) noexcept
+			: data_(reinterpret_cast<byte_type*>(values.data())), size_(values.size()), stride_(sizeof(T))
+		{
+		}
+
+		strided_span(std::vector<value_type>& values) noexcept
+			: strided_span(span<T>(values))
+		{
+		}
+
+		template<typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+		strided_span(const std::vector<value_type>& values) noexcept
+			: strided_span(span<T>(values))
+		{
+		}
+
+		/**
+		 * @brief View the elements of a mutable strided view as const.
+		 */
+		template<typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+		strided_span(const strided_span<U>& other) noexcept
+			: data_(reinterpret_cast<byte_type*>(other.data())), size_(other.size()), stride_(other.stride())
+		{
+		}
+
+		T* data() const noexcept { return reinterpret_cast<T*>(data_); }
+		size_t size() const noexcept { return size_; }
+		size_t stride() const noexcept { return stride_; }
+		bool empty() const noexcept { return size_ == 0; }
+		bool contiguous() const noexcept { return stride_ == sizeof(T); }
+		T& operator[](size_t i) const noexcept { return *reinterpret_cast<T*>(data_ + i * stride_); }
+
+	private:
+		byte_type* data_ = nullptr;
+		size_t size_ = 0;
+		size_t stride_ = sizeof(T);
+	};
+
+	/**
+	 * @brief View one arithmetic field of every record in a vector.
+	 *
+	 * @tparam R The record type.
+	 * @tparam M The field type.
+	 * @tparam C The class declaring the field; R or a base of R.
+	 * @param records The records.
+	 * @param member Pointer to the field.
+	 * @return A strided view over the field, valid while records is not resized.
+	 */
+	template<typename R, typename M, typename C,
+		typename = std::enable_if_t<std::is_arithmetic_v<M> && std::is_base_of_v<C, R>>>
+	strided_span<const M> project(const std::vector<R>& records, M C::* member)
+	{
+		if (records.empty()) return strided_span<const M>(nullptr, 0, sizeof(R));
+		return strided_span<const M>(&(records.front().*member), records.size(), sizeof(R));
+	}
+
+	namespace detail
+	{
+		template<typename Projection, typename R, typename = void>
+		struct is_projection : std::false_type
+		{
+		};
+
+		template<typename Projection, typename R>
+		struct is_projection<Projection, R, std::enable_if_t<std::is_invocable_v<const Projection&, const R&>>>
+			: std::is_arithmetic<std::decay_t<std::invoke_result_t<const Projection&, const R&>>>
+		{
+		};
+
+		template<typename Projection, typename R>
+		inline constexpr bool is_projection_v = is_projection<Projection, R>::value;
+
+		/**
+		 * @brief Records seen through a callable projection.
+		 */
+		template<typename R, typename Projection>
+		struct ProjectedView
+		{
+			using value_type = std::decay_t<std::invoke_result_t<const Projection&, const R&>>;
+
+			const R* records;
+			size_t count;
+			Projection projection;
+
+			size_t size() const { return count; }
+		};
+
+		template<typename R, typename Projection>
+		auto make_view(const std::vector<R>& records, const Projection& projection)
+		{
+			if constexpr (std::is_member_object_pointer_v<Projection>) return project(records, projection);
+			else return ProjectedView<R, Projection>{ records.data(), records.size(), projection };
+		}
+
+		/**
+		 * @brief Copy n elements spaced Step elements apart.
+		 *
+		 * A compile-time step lets the compiler vectorise the loads.
+		 */
+		template<size_t Step, typename T>
+		void gather_fixed(const unsigned char* base, size_t n, T* out)
+		{
+			for (size_t i = 0; i < n; ++i) std::memcpy(out + i, base + i * Step * sizeof(T), sizeof(T));
+		}
+
+		template<typename T>
+		void gather(const unsigned char* base, size_t stride, size_t n, T* out)
+		{
+			switch (stride % sizeof(T) == 0 ? stride / sizeof(T) : 0)
+			{
+			case 2: gather_fixed<2>(base, n, out); break;
+			case 3: gather_fixed<3>(base, n, out); break;
+			case 4: gather_fixed<4>(base, n, out); break;
+			case 8: gather_fixed<8>(base, n, out); break;
+			default:
+				for (size_t i = 0; i < n; ++i) std::memcpy(out + i, base + i * stride, sizeof(T));
+			}
+		}
+
+		/**
+		 * @brief Hand a strided view to fn(const T*, size_t) in contiguous blocks.
+		 *
+		 * Contiguous views are passed straight through; otherwise the elements are
+		 * gathered into a cache-sized buffer one block at a time.
+		 */
+		template<typename T, typename Function>
+		void for_each_block(const strided_span<T>& view, Function fn)
+		{
+			using V = std::remove_cv_t<T>;
+			if (view.empty()) return;
+			if (view.contiguous())
+			{
+				fn(static_cast<const V*>(view.data()), view.size());
+				return;
+			}
+			constexpr size_t block = 1024;
+			V buffer[block];
+			for (size_t begin = 0; begin < view.size(); begin += block)
+			{
+				size_t len = std::min(block, view.size() - begin);
+				gather(reinterpret_cast<const unsigned char*>(&view[begin]), view.stride(), len, buffer);
+				fn(static_cast<const V*>(buffer), len);
+			}
+		}
+
+		/**
+		 * @brief Hand the projected values of some records to fn(const V*, size_t) in blocks.
+		 */
+		template<typename R, typename Projection, typename Function>
+		void for_each_block(const ProjectedView<R, Projection>& view, Function fn)
+		{
+			using V = typename ProjectedView<R, Projection>::value_type;
+			constexpr size_t block = 1024;
+			V buffer[block];
+			for (size_t begin = 0; begin < view.size(); begin += block)
+			{
+				size_t len = std::min(block, view.size() - begin);
+				for (size_t i = 0; i < len; ++i) buffer[i] = std::invoke(view.projection, view.records[begin + i]);
+				fn(static_cast<const V*>(buffer), len);
+			}
+		}
+
+		template<typename View>
+		double view_sum(const View& view)
+		{
+			double total = 0.0;
+			for_each_block(view, [&](const auto* values, size_t n) { total = std::accumulate(values, values + n, total); });
+			return total;
+		}
+
+		template<typename View>
+		Moments view_moments(const View& view)
+		{
+			Moments moments;
+			for_each_block(view, [&](const auto* values, size_t n) { moments.push(values, n); });
+			return moments;
+		}
+
+		template<typename View>
+		double view_geo_mean(const View& view)
+		{
+			if (view.size() == 0) return 0.0;
+			double product = 1.0;
+			for_each_block(view, [&](const auto* values, size_t n) { product = std::accumulate(values, values + n, product, std::multiplies<double>()); });
+			return std::pow(product, 1.0 / view.size());
+		}
+
+		/**
+		 * @brief The elements of a view, sorted; the order statistics need a sortable copy.
+		 */
+		template<typename View>
+		std::vector<typename View::value_type> view_sorted(const View& view)
+		{
+			std::vector<typename View::value_type> values;
+			values.reserve(view.size());
+			for_each_block(view, [&](const auto* block, size_t n) { values.insert(values.end(), block, block + n); });
+			if (!detail::is_sorted(values.begin(), values.end())) parallel_sort(values.begin(), values.end());
+			return values;
+		}
+
+		template<typename View>
+		double view_percentile(const View& view, double p)
+		{
+			if (view.size() == 0) return 0.0;
+			auto values = view_sorted(view);
+			return sorted_percentile(values.begin(), values.end(), p);
+		}
+
+		template<typename View>
+		double view_iqr(const View& view)
+		{
+			if (view.size() == 0) return 0.0;
+			auto values = view_sorted(view);
+			return sorted_third_quartile(values.begin(), values.end()) - sorted_first_quartile(values.begin(), values.end());
+		}
+	}
+
+	/**
+	 * @brief Calculate the sum of the elements of a strided view.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The sum of the elements.
+	 */
+	template<typename T>
+	double sum(strided_span<T> data)
+	{
+		return detail::view_sum(data);
+	}
+
+	/**
+	 * @brief Calculate the sum of a projected field over a vector of records.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The sum of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double sum(const std::vector<R>& records, Projection projection)
+	{
+		return detail::view_sum(detail::make_view(records, projection));
+	}
+
+	/**
+	 * @brief Calculate the arithmetic mean of the elements of a strided view.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The arithmetic mean of the elements.
+	 */
+	template<typename T>
+	double mean(strided_span<T> data)
+	{
+		if (data.empty()) return 0.0;
+		return sum(data) / data.size();
+	}
+
+	/**
+	 * @brief Calculate the arithmetic mean of a projected field over a vector of records.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The arithmetic mean of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double mean(const std::vector<R>& records, Projection projection)
+	{
+		if (records.empty()) return 0.0;
+		return sum(records, projection) / records.size();
+	}
+
+	/**
+	 * @brief Calculate the variance of the elements of a strided view.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The variance of the elements.
+	 */
+	template<typename T>
+	double variance(strided_span<T> data)
+	{
+		return detail::view_moments(data).variance();
+	}
+
+	/**
+	 * @brief Calculate the variance of a projected field over a vector of records.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The variance of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double variance(const std::vector<R>& records, Projection projection)
+	{
+		return detail::view_moments(detail::make_view(records, projection)).variance();
+	}
+
+	/**
+	 * @brief Calculate the standard deviation of the elements of a strided view.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The standard deviation of the elements.
+	 */
+	template<typename T>
+	double stdev(strided_span<T> data)
+	{
+		return std::sqrt(variance(data));
+	}
+
+	/**
+	 * @brief Calculate the standard deviation of a projected field over a vector of records.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The standard deviation of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double stdev(const std::vector<R>& records, Projection projection)
+	{
+		return std::sqrt(variance(records, projection));
+	}
+
+	/**
+	 * @brief Calculate the range of the elements of a strided view.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The range of the elements.
+	 */
+	template<typename T>
+	double range(strided_span<T> data)
+	{
+		return detail::view_moments(data).range();
+	}
+
+	/**
+	 * @brief Calculate the range of a projected field over a vector of records.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The range of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double range(const std::vector<R>& records, Projection projection)
+	{
+		return detail::view_moments(detail::make_view(records, projection)).range();
+	}
+
+	/**
+	 * @brief Calculate the percentile of the elements of a strided view using linear interpolation.
+	 *
+	 * The elements are copied once into a buffer to be sorted.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @param p The percentile to calculate (0-100).
+	 * @return The value at the specified percentile.
+	 */
+	template<typename T>
+	double percentile(strided_span<T> data, double p)
+	{
+		return detail::view_percentile(data, p);
+	}
+
+	/**
+	 * @brief Calculate the percentile of a projected field over a vector of records.
+	 *
+	 * The projected values are copied once into a buffer to be sorted.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @param p The percentile to calculate (0-100).
+	 * @return The value at the specified percentile.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double percentile(const std::vector<R>& records, Projection projection, double p)
+	{
+		return detail::view_percentile(detail::make_view(records, projection), p);
+	}
+
+	/**
+	 * @brief Calculate the median of the elements of a strided view.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The median of the elements.
+	 */
+	template<typename T>
+	double median(strided_span<T> data)
+	{
+		return detail::view_percentile(data, 50.0);
+	}
+
+	/**
+	 * @brief Calculate the median of a projected field over a vector of records.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The median of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double median(const std::vector<R>& records, Projection projection)
+	{
+		return detail::view_percentile(detail::make_view(records, projection), 50.0);
+	}
+
+	/**
+	 * @brief Calculate the geometric mean of the elements of a strided view.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The geometric mean of the elements.
+	 */
+	template<typename T>
+	double geo_mean(strided_span<T> data)
+	{
+		return detail::view_geo_mean(data);
+	}
+
+	/**
+	 * @brief Calculate the geometric mean of a projected field over a vector of records.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The geometric mean of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double geo_mean(const std::vector<R>& records, Projection projection)
+	{
+		return detail::view_geo_mean(detail::make_view(records, projection));
+	}
+
+	/**
+	 * @brief Calculate the first quartile (Q1) of the elements of a strided view.
+	 *
+	 * The elements are copied once into a buffer to be sorted.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The first quartile (Q1) of the elements.
+	 */
+	template<typename T>
+	double first_quartile(strided_span<T> data)
+	{
+		auto values = detail::view_sorted(data);
+		return detail::sorted_first_quartile(values.begin(), values.end());
+	}
+
+	/**
+	 * @brief Calculate the first quartile (Q1) of a projected field over a vector of records.
+	 *
+	 * The projected values are copied once into a buffer to be sorted.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The first quartile (Q1) of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double first_quartile(const std::vector<R>& records, Projection projection)
+	{
+		auto values = detail::view_sorted(detail::make_view(records, projection));
+		return detail::sorted_first_quartile(values.begin(), values.end());
+	}
+
+	/**
+	 * @brief Calculate the third quartile (Q3) of the elements of a strided view.
+	 *
+	 * The elements are copied once into a buffer to be sorted.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The third quartile (Q3) of the elements.
+	 */
+	template<typename T>
+	double third_quartile(strided_span<T> data)
+	{
+		auto values = detail::view_sorted(data);
+		return detail::sorted_third_quartile(values.begin(), values.end());
+	}
+
+	/**
+	 * @brief Calculate the third quartile (Q3) of a projected field over a vector of records.
+	 *
+	 * The projected values are copied once into a buffer to be sorted.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The third quartile (Q3) of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double third_quartile(const std::vector<R>& records, Projection projection)
+	{
+		auto values = detail::view_sorted(detail::make_view(records, projection));
+		return detail::sorted_third_quartile(values.begin(), values.end());
+	}
+
+	/**
+	 * @brief Calculate the interquartile range (IQR) of the elements of a strided view.
+	 *
+	 * The elements are copied once into a buffer to be sorted.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The interquartile range (IQR) of the elements.
+	 */
+	template<typename T>
+	double iqr(strided_span<T> data)
+	{
+		return detail::view_iqr(data);
+	}
+
+	/**
+	 * @brief Calculate the interquartile range (IQR) of a projected field over a vector of records.
+	 *
+	 * The projected values are copied once into a buffer to be sorted.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The interquartile range (IQR) of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double iqr(const std::vector<R>& records, Projection projection)
+	{
+		return detail::view_iqr(detail::make_view(records, projection));
+	}
+
+	/**
+	 * @brief Calculate the coefficient of variation of the elements of a strided view.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param data The view.
+	 * @return The coefficient of variation of the elements.
+	 */
+	template<typename T>
+	double coeff_of_variation(strided_span<T> data)
+	{
+		if (data.empty()) return 0.0;
+		Moments moments = detail::view_moments(data);
+		return moments.stdev() / moments.mean();
+	}
+
+	/**
+	 * @brief Calculate the coefficient of variation of a projected field over a vector of records.
+	 *
+	 * @tparam R The record type.
+	 * @tparam Projection Member object pointer, or callable returning an arithmetic value from a record.
+	 * @param records The records.
+	 * @param projection The field to reduce.
+	 * @return The coefficient of variation of the projected values.
+	 */
+	template<typename R, typename Projection, typename = std::enable_if_t<detail::is_projection_v<Projection, R>>>
+	double coeff_of_variation(const std::vector<R>& records, Projection projection)
+	{
+		if (records.empty()) return 0.0;
+		Moments moments = detail::view_moments(detail::make_view(records, projection));
+		return moments.stdev() / moments.mean();
+	}
+
+	/**
+	 * @brief Non-owning view of a row-major matrix.
+	 *
+	 * @tparam T The element type; use a const type for read-only views.
+	 */
+	template<typename T>
+	class matrix_span
+	{
+	public:
+		using element_type = T;
+		using value_type = std::remove_cv_t<T>;
+
+		constexpr matrix_span() noexcept = default;
+
+		/**
+		 * @brief View rows x cols elements starting at data.
+		 *
+		 * @param data Pointer to the first element of the first row.
+		 * @param rows The number of rows.
+		 * @param cols The number of columns.
+		 * @param row_stride The distance between the starts of consecutive rows, in elements.
+		 */
+		matrix_span(T* data, size_t rows, size_t cols, size_t row_stride)
+			: data_(data), rows_(rows), cols_(cols), row_stride_(row_stride)
+		{
+			if (row_stride_ < cols_) throw std::invalid_argument("Row stride must be at least the number of columns.");
+		}
+
+		matrix_span(T* data, size_t rows, size_t cols) noexcept
+			: data_(data), rows_(rows), cols_(cols), row_stride_(cols)
+		{
+		}
+
+		/**
+		 * @brief View a vector as a row-major matrix with the given number of columns.
+		 *
+		 * @param data The elements, row after row.
+		 * @param cols The number of columns; must divide the size of data.
+		 */
+		template<typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+		matrix_span(const std::vector<value_type>& data, size_t cols)
+			: matrix_span(data.data(), cols == 0 ? 0 : data.size() / cols, cols)
+		{
+			if (cols == 0 || data.size() % cols != 0) throw std::invalid_argument("Data size must be a multiple of the number of columns.");
+		}
+
+		/**
+		 * @brief View the elements of a mutable matrix view as const.
+		 */
+		template<typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+		matrix_span(const matrix_span<U>& other) noexcept
+			: data_(other.data()), rows_(other.rows()), cols_(other.cols()), row_stride_(other.row_stride())
+		{
+		}
+
+		T* data() const noexcept { return data_; }
+		size_t rows() const noexcept { return rows_; }
+		size_t cols() const noexcept { return cols_; }
+		size_t row_stride() const noexcept { return row_stride_; }
+		bool empty() const noexcept { return rows_ == 0 || cols_ == 0; }
+		T& operator()(size_t r, size_t c) const noexcept { return data_[r * row_stride_ + c]; }
+
+		/**
+		 * @brief The elements of one row.
+		 */
+		span<T> row(size_t r) const noexcept { return span<T>(data_ + r * row_stride_, cols_); }
+
+		/**
+		 * @brief The elements of one column, as a strided view.
+		 */
+		strided_span<T> column(size_t c) const { return strided_span<T>(data_ + c, rows_, row_stride_ * sizeof(T)); }
+
+	private:
+		T* data_ = nullptr;
+		size_t rows_ = 0;
+		size_t cols_ = 0;
+		size_t row_stride_ = 0;
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief One Moments accumulator per column, mergeable as a whole for tree_merge.
+		 */
+		struct ColumnMoments
+		{
+			std::vector<Moments> columns;
+
+			/**
+			 * @brief Add a range of rows, tiled so each tile stays in cache for both passes.
+			 *
+			 * Every inner loop runs along a row, updating a contiguous run of column
+			 * accumulators, so it vectorises across columns without reassociating
+			 * any single sum. Each tile is then merged into the columns with Chan's
+			 * formula, as Moments::push does for its blocks.
+			 */
+			template<typename T>
+			void push_rows(const matrix_span<const T>& matrix, size_t first, size_t last)
+			{
+				constexpr size_t max_tile_cols = 512;
+				constexpr size_t tile_bytes = 1 << 16;
+				size_t cols = matrix.cols();
+				if (columns.size() != cols) columns.resize(cols);
+				size_t tile_cols = std::min(cols, max_tile_cols);
+				size_t tile_rows = std::max<size_t>(16, tile_bytes / (tile_cols * sizeof(T)));
+				std::vector<double> s(tile_cols), lo(tile_cols), hi(tile_cols), m2(tile_cols);
+				for (size_t c0 = 0; c0 < cols; c0 += tile_cols)
+				{
+					size_t width = std::min(tile_cols, cols - c0);
+					for (size_t r0 = first; r0 < last; r0 += tile_rows)
+					{
+						size_t height = std::min(tile_rows, last - r0);
+						const T* row = &matrix(r0, c0);
+						for (size_t c = 0; c < width; ++c)
+						{
+							s[c] = 0.0;
+							lo[c] = hi[c] = static_cast<double>(row[c]);
+							m2[c] = 0.0;
+						}
+						for (size_t r = 0; r < height; ++r, row += matrix.row_stride())
+						{
+							for (size_t c = 0; c < width; ++c)
+							{
+								double x = static_cast<double>(row[c]);
+								s[c] += x;
+								lo[c] = std::min(lo[c], x);
+								hi[c] = std::max(hi[c], x);
+							}
+						}
+						for (size_t c = 0; c < width; ++c) s[c] /= height;
+						row = &matrix(r0, c0);
+						for (size_t r = 0; r < height; ++r, row += matrix.row_stride())
+						{
+							for (size_t c = 0; c < width; ++c)
+							{
+								double d = static_cast<double>(row[c]) - s[c];
+								m2[c] += d * d;
+							}
+						}
+						for (size_t c = 0; c < width; ++c) columns[c0 + c].merge(Moments(height, s[c], m2[c], lo[c], hi[c]));
+					}
+				}
+			}
+
+			void merge(const ColumnMoments& other)
+			{
+				if (columns.empty())
+				{
+					columns = other.columns;
+					return;
+				}
+				for (size_t c = 0; c < other.columns.size(); ++c) columns[c].merge(other.columns[c]);
+			}
+		};
+
+		/**
+		 * @brief Percentile of an unsorted range by selection; reorders the range.
+		 *
+		 * Interpolates exactly as sorted_percentile does on the sorted range.
+		 */
+		template<typename Iterator>
+		double select_percentile(Iterator first, Iterator last, double p)
+		{
+			size_t n = static_cast<size_t>(last - first);
+			if (n == 0) return 0.0;
+			double rank = (p / 100) * (n - 1);
+			size_t lower = static_cast<size_t>(std::floor(rank));
+			double weight = rank - lower;
+			std::nth_element(first, first + lower, last);
+			if (lower + 1 >= n) return first[lower];
+			auto upper = *std::min_element(first + lower + 1, last);
+			return first[lower] + weight * (upper - first[lower]);
+		}
+
+		/**
+		 * @brief Median of an unsorted range by selection; reorders the range.
+		 */
+		template<typename Iterator>
+		double select_median(Iterator first, Iterator last)
+		{
+			size_t n = static_cast<size_t>(last - first);
+			if (n == 0) return 0.0;
+			std::nth_element(first, first + n / 2, last);
+			if (n % 2 != 0) return first[n / 2];
+			return (*std::max_element(first, first + n / 2) + first[n / 2]) / 2.0;
+		}
+
+		/**
+		 * @brief Apply a selection to every column, a few columns at a time.
+		 *
+		 * A tile of columns is transposed into contiguous per-column buffers, row
+		 * by row, so the reads stay sequential and only the tile is held in
+		 * memory. Tiles are processed in parallel, each chunk with its own buffer.
+		 *
+		 * @param select Called as select(first, last) on each column's buffer.
+		 */
+		template<typename T, typename Select>
+		std::vector<double> select_columns(const matrix_span<const T>& matrix, Select select)
+		{
+			constexpr size_t tile_cols = 8;
+			size_t rows = matrix.rows(), cols = matrix.cols();
+			std::vector<double> result(cols, 0.0);
+			if (rows == 0) return result;
+			size_t tiles = (cols + tile_cols - 1) / tile_cols;
+			size_t grain = std::max<size_t>(1, grain_size(ParallelAlgorithm::sort) / (rows * tile_cols));
+			parallel_for(tiles, grain, [&](size_t tb, size_t te) {
+				std::vector<T> buffer(rows * tile_cols);
+				for (size_t t = tb; t < te; ++t)
+				{
+					size_t c0 = t * tile_cols, width = std::min(tile_cols, cols - c0);
+					for (size_t r = 0; r < rows; ++r)
+					{
+						const T* row = &matrix(r, c0);
+						for (size_t c = 0; c < width; ++c) buffer[c * rows + r] = row[c];
+					}
+					for (size_t c = 0; c < width; ++c)
+						result[c0 + c] = select(buffer.begin() + c * rows, buffer.begin() + (c + 1) * rows);
+				}
+			});
+			return result;
+		}
+	}
+
+	/**
+	 * @brief Calculate the moments of every column of a row-major matrix in one pass.
+	 *
+	 * Row ranges are reduced in parallel and combined with tree_merge.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param matrix The matrix.
+	 * @return One Moments accumulator per column.
+	 */
+	template<typename T>
+	std::vector<Moments> column_moments(matrix_span<T> matrix)
+	{
+		if (matrix.cols() == 0) return {};
+		matrix_span<const std::remove_cv_t<T>> view = matrix;
+		size_t rows_per_leaf = std::max<size_t>(64, grain_size(ParallelAlgorithm::reduce) / matrix.cols());
+		size_t leaves = (matrix.rows() + rows_per_leaf - 1) / rows_per_leaf;
+		detail::ColumnMoments merged = detail::tree_merge<detail::ColumnMoments>(leaves, 1, [&](size_t leaf) {
+			detail::ColumnMoments part;
+			part.push_rows(view, leaf * rows_per_leaf, std::min(matrix.rows(), (leaf + 1) * rows_per_leaf));
+			return part;
+		});
+		merged.columns.resize(matrix.cols());
+		return merged.columns;
+	}
+
+	/**
+	 * @brief Calculate the arithmetic mean of every column of a row-major matrix.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param matrix The matrix.
+	 * @return The mean of each column.
+	 */
+	template<typename T>
+	std::vector<double> column_means(matrix_span<T> matrix)
+	{
+		std::vector<Moments> moments = column_moments(matrix);
+		std::vector<double> result(moments.size());
+		std::transform(moments.begin(), moments.end(), result.begin(), [](const Moments& m) { return m.mean(); });
+		return result;
+	}
+
+	/**
+	 * @brief Calculate the variance of every column of a row-major matrix.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param matrix The matrix.
+	 * @return The variance of each column.
+	 */
+	template<typename T>
+	std::vector<double> column_variances(matrix_span<T> matrix)
+	{
+		std::vector<Moments> moments = column_moments(matrix);
+		std::vector<double> result(moments.size());
+		std::transform(moments.begin(), moments.end(), result.begin(), [](const Moments& m) { return m.variance(); });
+		return result;
+	}
+
+	/**
+	 * @brief Calculate the standard deviation of every column of a row-major matrix.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param matrix The matrix.
+	 * @return The standard deviation of each column.
+	 */
+	template<typename T>
+	std::vector<double> column_stdevs(matrix_span<T> matrix)
+	{
+		std::vector<Moments> moments = column_moments(matrix);
+		std::vector<double> result(moments.size());
+		std::transform(moments.begin(), moments.end(), result.begin(), [](const Moments& m) { return m.stdev(); });
+		return result;
+	}
+
+	/**
+	 * @brief Calculate the percentile of every column of a row-major matrix.
+	 *
+	 * Each column is found by selection rather than a full sort.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param matrix The matrix.
+	 * @param p The percentile to calculate (0-100).
+	 * @return The value at the specified percentile of each column.
+	 */
+	template<typename T>
+	std::vector<double> column_percentiles(matrix_span<T> matrix, double p)
+	{
+		if (p < 0 || p > 100) throw std::out_of_range("Percentile must be between 0 and 100.");
+		return detail::select_columns(matrix_span<const std::remove_cv_t<T>>(matrix), [p](auto first, auto last) { return detail::select_percentile(first, last, p); });
+	}
+
+	/**
+	 * @brief Calculate the median of every column of a row-major matrix.
+	 *
+	 * @tparam T The type of the elements, const or not.
+	 * @param matrix The matrix.
+	 * @return The median of each column.
+	 */
+	template<typename T>
+	std::vector<double> column_medians(matrix_span<T> matrix)
+	{
+		return detail::select_columns(matrix_span<const std::remove_cv_t<T>>(matrix), [](auto first, auto last) { return detail::select_median(first, last); });
+	}
+
+	/**
+	 * @brief Mergeable frequency table of discrete values.
+	 *
+	 * Integer values are counted in a flat array indexed by value while the
+	 * values seen span fewer than flat_limit integers. Wider integer ranges and
+	 * all other types use an open-addressing hash table with linear probing.
+	 * A table moves from the flat array to the hash table at most once. Mode,
+	 * distinct count, entropy and top-k are all read from the one table.
+	 * Floating-point NaN values never compare equal, so they are counted
+	 * together as a single value that orders after every other value.
+	 *
+	 * @tparam T The value type; must be equality comparable and ordered by operator<.
+	 * @tparam Hash The hash function used once the table is hashed.
+	 */
+	template<typename T, typename Hash = std::hash<T>>
+	class FrequencyTable
+	{
+		static constexpr bool flat_capable = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+	public:
+		/**
+		 * @brief The widest integer range counted in a flat array.
+		 */
+		static constexpr size_t flat_limit = size_t(1) << 16;
+
+		FrequencyTable() = default;
+
+		/**
+		 * @brief Count one occurrence of a value.
+		 *
+		 * @param value The value.
+		 */
+		void push(const T& value)
+		{
+			add(value, 1);
+		}
+
+		/**
+		 * @brief Count a contiguous batch of values.
+		 *
+		 * @param data Pointer to the first value.
+		 * @param n The number of values.
+		 */
+		void push(const T* data, size_t n)
+		{
+			if (n == 0) return;
+			if constexpr (flat_capable)
+			{
+				if (!hashed_)
+				{
+					auto [lo, hi] = std::minmax_element(data, data + n);
+					if (reserve_flat(*lo, *hi))
+					{
+						uint64_t* counts = flat_.data();
+						for (size_t i = 0; i < n; ++i) ++counts[flat_index(data[i])];
+						total_ += n;
+						return;
+					}
+					to_hashed();
+				}
+			}
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (is_nan(data[i])) ++nans_;
+				else add_hashed(data[i], 1);
+			}
+			total_ += n;
+		}
+
+		/**
+		 * @brief Count every value of a vector.
+		 *
+		 * @param data The values.
+		 */
+		void push(const std::vector<T>& data)
+		{
+			push(data.data(), data.size());
+		}
+
+		/**
+		 * @brief Combine another table into this one.
+		 *
+		 * @param other The table to merge.
+		 */
+		void merge(const FrequencyTable& other)
+		{
+			if constexpr (flat_capable)
+			{
+				if (!hashed_ && !other.hashed_ && !other.flat_.empty()
+					&& reserve_flat(other.base_, other.flat_value(other.flat_.size() - 1)))
+				{
+					size_t offset = flat_index(other.base_);
+					for (size_t i = 0; i < other.flat_.size(); ++i) flat_[offset + i] += other.flat_[i];
+					total_ += other.total_;
+					return;
+				}
+			}
+			other.for_each([this](const T& value, uint64_t count) { add(value, count); });
+		}
+
+		/**
+		 * @brief Reset to the empty state.
+		 */
+		void clear() { *this = FrequencyTable(); }
+
+		/**
+		 * @brief The number of values counted.
+		 */
+		uint64_t count() const { return total_; }
+
+		/**
+		 * @brief Whether the table has moved from the flat array to the hash table.
+		 */
+		bool hashed() const { return hashed_; }
+
+		/**
+		 * @brief The number of distinct values counted.
+		 */
+		size_t distinct() const
+		{
+			if (!hashed_) return static_cast<size_t>(std::count_if(flat_.begin(), flat_.end(), [](uint64_t c) { return c != 0; }));
+			return size_ + (nans_ != 0 ? 1 : 0);
+		}
+
+		/**
+		 * @brief The number of times a value was counted.
+		 *
+		 * @param value The value.
+		 */
+		uint64_t frequency(const T& value) const
+		{
+			if constexpr (flat_capable)
+			{
+				if (!hashed_)
+				{
+					if (flat_.empty() || value < base_) return 0;
+					size_t index = flat_index(value);
+					return index < flat_.size() ? flat_[index] : 0;
+				}
+			}
+			if (is_nan(value)) return nans_;
+			if (size_ == 0) return 0;
+			return slots_[find_slot(value)].count;
+		}
+
+		/**
+		 * @brief Call fn(value, count) for every distinct value, in no particular order.
+		 */
+		template<typename Function>
+		void for_each(Function fn) const
+		{
+			if (!hashed_)
+			{
+				if constexpr (flat_capable)
+				{
+					for (size_t i = 0; i < flat_.size(); ++i)
+						if (flat_[i] != 0) fn(flat_value(i), flat_[i]);
+				}
+				return;
+			}
+			for (const Slot& slot : slots_)
+				if (slot.count != 0) fn(slot.key, slot.count);
+			if constexpr (std::is_floating_point_v<T>)
+			{
+				if (nans_ != 0) fn(std::numeric_limits<T>::quiet_NaN(), nans_);
+			}
+		}
+
+		/**
+		 * @brief Every distinct value with its count, in ascending order of value.
+		 */
+		std::vector<std::pair<T, uint64_t>> table() const
+		{
+			std::vector<std::pair<T, uint64_t>> result;
+			result.reserve(distinct());
+			for_each([&](const T& value, uint64_t count) { result.emplace_back(value, count); });
+			if (hashed_) std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) { return less(a.first, b.first); });
+			return result;
+		}
+
+		/**
+		 * @brief The most frequent value; the smallest of them on a tie.
+		 *
+		 * @return The mode, or T() if the table is empty.
+		 */
+		T mode() const
+		{
+			T best = T();
+			uint64_t best_count = 0;
+			for_each([&](const T& value, uint64_t count) {
+				if (count > best_count || (count == best_count && less(value, best)))
+				{
+					best = value;
+					best_count = count;
+				}
+			});
+			return best;
+		}
+
+		/**
+		 * @brief The k most frequent values, by descending count and then ascending value.
+		 *
+		 * @param k The number of values to return.
+		 */
+		std::vector<std::pair<T, uint64_t>> top_k(size_t k) const
+		{
+			std::vector<std::pair<T, uint64_t>> result;
+			result.reserve(distinct());
+			for_each([&](const T& value, uint64_t count) { result.emplace_back(value, count); });
+			auto order = [](const auto& a, const auto& b) { return a.second != b.second ? a.second > b.second : less(a.first, b.first); };
+			k = std::min(k, result.size());
+			std::partial_sort(result.begin(), result.begin() + k, result.end(), order);
+			result.resize(k);
+			return result;
+		}
+
+		/**
+		 * @brief The Shannon entropy of the empirical distribution, in bits.
+		 */
+		double entropy() const
+		{
+			if (total_ == 0) return 0.0;
+			double h = 0.0;
+			for_each([&](const T&, uint64_t count) {
+				double p = static_cast<double>(count) / total_;
+				h -= p * std::log2(p);
+			});
+			return h;
+		}
+
+	private:
+		using Unsigned = std::make_unsigned_t<std::conditional_t<flat_capable, T, int>>;
+
+		size_t flat_index(T value) const
+		{
+			return static_cast<size_t>(static_cast<Unsigned>(static_cast<Unsigned>(value) - static_cast<Unsigned>(base_)));
+		}
+
+		T flat_value(size_t index) const
+		{
+			return static_cast<T>(static_cast<Unsigned>(static_cast<Unsigned>(base_) + index));
+		}
+
+		/**
+		 * @brief Widen the flat array to cover [lo, hi].
+		 *
+		 * @return False, leaving the array unchanged, if the range would exceed flat_limit.
+		 */
+		bool reserve_flat(T lo, T hi)
+		{
+			if (!flat_.empty())
+			{
+				lo = std::min(lo, base_);
+				hi = std::max(hi, flat_value(flat_.size() - 1));
+			}
+			if (static_cast<Unsigned>(static_cast<Unsigned>(hi) - static_cast<Unsigned>(lo)) >= flat_limit) return false;
+			size_t width = static_cast<size_t>(static_cast<Unsigned>(static_cast<Unsigned>(hi) - static_cast<Unsigned>(lo))) + 1;
+			if (flat_.empty())
+			{
+				flat_.assign(width, 0);
+			}
+			else if (width != flat_.size() || lo != base_)
+			{
+				std::vector<uint64_t> widened(width, 0);
+				size_t offset = static_cast<size_t>(static_cast<Unsigned>(static_cast<Unsigned>(base_) - static_cast<Unsigned>(lo)));
+				std::copy(flat_.begin(), flat_.end(), widened.begin() + offset);
+				flat_.swap(widened);
+			}
+			base_ = lo;
+			return true;
+		}
+
+		void to_hashed()
+		{
+			std::vector<uint64_t> flat;
+			flat.swap(flat_);
+			hashed_ = true;
+			if constexpr (flat_capable)
+			{
+				for (size_t i = 0; i < flat.size(); ++i)
+					if (flat[i] != 0) add_hashed(static_cast<T>(static_cast<Unsigned>(static_cast<Unsigned>(base_) + i)), flat[i]);
+			}
+		}
+
+		static bool is_nan(const T& value)
+		{
+			if constexpr (std::is_floating_point_v<T>) return value != value;
+			else return false;
+		}
+
+		// operator< with NaN after every other value, a strict weak order for sorting.
+		static bool less(const T& a, const T& b)
+		{
+			if (is_nan(b)) return !is_nan(a);
+			if (is_nan(a)) return false;
+			return a < b;
+		}
+
+		void add(const T& value, uint64_t count)
+		{
+			if (is_nan(value))
+			{
+				nans_ += count;
+				total_ += count;
+				return;
+			}
+			if constexpr (flat_capable)
+			{
+				if (!hashed_)
+				{
+					if (reserve_flat(value, value))
+					{
+						flat_[flat_index(value)] += count;
+						total_ += count;
+						return;
+					}
+					to_hashed();
+				}
+			}
+			add_hashed(value, count);
+			total_ += count;
+		}
+
+		static size_t mix(size_t h)
+		{
+			// splitmix64 finaliser; std::hash of an integer is often the identity.
+			uint64_t x = static_cast<uint64_t>(h);
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+			return static_cast<size_t>(x ^ (x >> 31));
+		}
+
+		size_t find_slot(const T& value) const
+		{
+			size_t mask = slots_.size() - 1;
+			size_t slot = mix(Hash{}(value)) & mask;
+			while (slots_[slot].count != 0 && !(slots_[slot].key == value)) slot = (slot + 1) & mask;
+			return slot;
+		}
+
+		void add_hashed(const T& value, uint64_t count)
+		{
+			if ((size_ + 1) * 2 > slots_.size()) grow();
+			Slot& slot = slots_[find_slot(value)];
+			if (slot.count == 0)
+			{
+				slot.key = value;
+				++size_;
+			}
+			slot.count += count;
+		}
+
+		void grow()
+		{
+			std::vector<Slot> slots(std::max<size_t>(16, slots_.size() * 2));
+			slots.swap(slots_);
+			size_ = 0;
+			for (const Slot& slot : slots)
+				if (slot.count != 0) add_hashed(slot.key, slot.count);
+		}
+
+		// A key and its count share a cache line. An empty slot has a count of
+		// zero; occupied slots always hold at least one.
+		struct Slot
+		{
+			T key = T();
+			uint64_t count = 0;
+		};
+
+		std::vector<Slot> slots_;
+		size_t size_ = 0;
+		uint64_t nans_ = 0;
+		std::vector<uint64_t> flat_;
+		T base_ = T();
+		bool hashed_ = !flat_capable;
+		uint64_t total_ = 0;
+	};
+
+	/**
+	 * @brief Count the values of a vector into a frequency table.
+	 *
+	 * Each worker counts one contiguous share of the data into its own table
+	 * and the tables are merged with tree_merge. A table costs a merge pass
+	 * over all its distinct values, so there is one per worker rather than one
+	 * per grain.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of values.
+	 * @return The frequency table of the values.
+	 */
+	template<typename T>
+	FrequencyTable<T> frequency_table(const std::vector<T>& data)
+	{
+		size_t grain = grain_size(ParallelAlgorithm::reduce);
+		size_t shares = std::min(detail::worker_count(), (data.size() + grain - 1) / grain);
+		return detail::tree_merge<FrequencyTable<T>>(shares, 1, [&](size_t c) {
+			FrequencyTable<T> table;
+			size_t first = c * data.size() / shares, last = (c + 1) * data.size() / shares;
+			table.push(data.data() + first, last - first);
+			return table;
+		});
+	}
+
+	/**
+	 * @brief Calculate the mode (most frequent value) of a vector of values.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of values.
+	 * @return The most frequent value, the smallest of them on a tie, or T() if data is empty.
+	 */
+	template<typename T>
+	T mode(const std::vector<T>& data)
+	{
+		return frequency_table(data).mode();
+	}
+
+	/**
+	 * @brief Count the distinct values of a vector.
+	 *
+	 * @tparam T The type of the elements in the vector.
+	 * @param data The vector of values.
+	 * @return The number of distinct values.
+	 */
+	template<typename T>
+	size_t distinct_count(const std::vector<T>& data)
+	{
+		return frequency_table(data).distinct();
+	}
+
 }
 
 #endif // !BASIC_STATS_HPP
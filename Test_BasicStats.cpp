@@ -2,6 +2,14 @@
 #include "gtest/gtest.h"
 #include <cmath>
 #include <stdexcept>
+#include <random>
+#include <tuple>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <map>
+#include <future>
+#include <filesystem>
 
 TEST(BasicStatsTests, Sum) {
 	EXPECT_DOUBLE_EQ(BasicStats::sum(std::vector<int>{1, 2, 3, 4, 5}), 15.0);
@@ -82,4 +90,1102 @@ TEST(BasicStatsTests, FilterWithCriteria) {
 	auto result = BasicStats::filter(std::vector<int>{1, 2, 3, 4, 5}, std::vector<int>{10, 20, 30, 40, 50}, [](int x) { return x > 30; });
 	EXPECT_EQ(result, std::vector<int>({ 4, 5 }));
 	EXPECT_THROW(BasicStats::filter(std::vector<int>{1, 2}, std::vector<int>{1}, [](int x) { return x > 0; }), std::invalid_argument);
-}
\ No newline at end of file
+}
+
+TEST(BasicStatsTests, RangeIndexMatchesSlices) {
+	std::vector<double> data;
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<double> dist(1e6, 1e6 + 100.0);
+	for (int i = 0; i < 1000; i++) data.push_back(dist(gen));
+	BasicStats::RangeIndex<double> index(data);
+	for (auto [first, last] : std::vector<std::pair<size_t, size_t>>{ {0, 1000}, {3, 17}, {31, 33}, {100, 900}, {999, 1000} }) {
+		std::vector<double> slice(data.begin() + first, data.begin() + last);
+		EXPECT_NEAR(index.sum(first, last), BasicStats::sum(slice), 1e-6);
+		EXPECT_NEAR(index.mean(first, last), BasicStats::mean(slice), 1e-9);
+		EXPECT_NEAR(index.variance(first, last), BasicStats::variance(slice), 1e-6);
+		EXPECT_DOUBLE_EQ(index.range(first, last), BasicStats::range(slice));
+	}
+	EXPECT_DOUBLE_EQ(index.mean(5, 5), 0.0);
+	EXPECT_THROW(index.sum(10, 1001), std::out_of_range);
+}
+
+TEST(BasicStatsTests, RangeIndexAppend) {
+	BasicStats::RangeIndex<int> index;
+	std::vector<int> data;
+	for (int i = 0; i < 200; i++) {
+		int value = (i * 37) % 101;
+		index.append(value);
+		data.push_back(value);
+	}
+	EXPECT_EQ(index.size(), 200u);
+	EXPECT_EQ(index.min(10, 150), *std::min_element(data.begin() + 10, data.begin() + 150));
+	EXPECT_EQ(index.max(10, 150), *std::max_element(data.begin() + 10, data.begin() + 150));
+	EXPECT_NEAR(index.stdev(0, 200), BasicStats::stdev(data), 1e-9);
+}
+
+TEST(BasicStatsTests, WaveletMatrixMatchesPercentile) {
+	std::vector<int> data;
+	std::mt19937 gen(7);
+	std::uniform_int_distribution<int> dist(-50, 50);
+	for (int i = 0; i < 2000; i++) data.push_back(dist(gen));
+	BasicStats::WaveletMatrix<int> index(data);
+	for (auto [first, last] : std::vector<std::pair<size_t, size_t>>{ {0, 2000}, {3, 4}, {10, 500}, {449, 1451} }) {
+		std::vector<int> slice(data.begin() + first, data.begin() + last);
+		std::vector<int> sorted = slice;
+		std::sort(sorted.begin(), sorted.end());
+		EXPECT_EQ(index.kth_smallest(first, last, 0), sorted.front());
+		EXPECT_EQ(index.kth_smallest(first, last, sorted.size() - 1), sorted.back());
+		for (double p : { 0.0, 10.0, 50.0, 99.0, 100.0 }) {
+			EXPECT_DOUBLE_EQ(index.percentile(first, last, p), BasicStats::percentile(slice, p));
+		}
+		EXPECT_DOUBLE_EQ(index.median(first, last), BasicStats::median(slice));
+	}
+	EXPECT_THROW(index.kth_smallest(5, 10, 5), std::out_of_range);
+	EXPECT_THROW(index.percentile(0, 10, 101), std::out_of_range);
+}
+
+TEST(BasicStatsTests, ECDFLookups) {
+	std::vector<int> data{ 5, 1, 4, 2, 2, 3, 9, 7 };
+	BasicStats::ECDF<int> ecdf(data);
+	EXPECT_DOUBLE_EQ(ecdf.cdf(0), 0.0);
+	EXPECT_DOUBLE_EQ(ecdf.cdf(2), 3.0 / 8.0);
+	EXPECT_DOUBLE_EQ(ecdf.cdf(6), 6.0 / 8.0);
+	EXPECT_DOUBLE_EQ(ecdf.cdf(9), 1.0);
+	EXPECT_EQ(ecdf.cdf(std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }),
+		(std::vector<double>{ 0.0, 0.125, 0.375, 0.5, 0.625, 0.75, 0.75, 0.875, 0.875, 1.0, 1.0 }));
+	for (double q : { 0.0, 0.1, 0.25, 0.5, 0.9, 1.0 }) {
+		EXPECT_DOUBLE_EQ(ecdf.quantile(q), BasicStats::percentile(data, 100 * q));
+	}
+	EXPECT_EQ(ecdf.quantile(std::vector<double>{ 0.25, 0.5 }), (std::vector<double>{ ecdf.quantile(0.25), ecdf.quantile(0.5) }));
+	EXPECT_THROW(ecdf.quantile(1.5), std::out_of_range);
+	EXPECT_DOUBLE_EQ(BasicStats::ECDF<int>(std::vector<int>{}).cdf(3), 0.0);
+}
+
+TEST(BasicStatsTests, MomentsMerge) {
+	std::vector<double> data{ 2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0 };
+	BasicStats::Moments all, left, right;
+	all.push(data);
+	for (size_t i = 0; i < 3; i++) left.push(data[i]);
+	right.push(data.data() + 3, data.size() - 3);
+	left.merge(right);
+	EXPECT_EQ(left.count(), 8u);
+	EXPECT_DOUBLE_EQ(left.mean(), 5.0);
+	EXPECT_DOUBLE_EQ(left.variance(), 4.0);
+	EXPECT_DOUBLE_EQ(all.variance(), BasicStats::variance(data));
+	EXPECT_DOUBLE_EQ(left.range(), 7.0);
+	EXPECT_DOUBLE_EQ(BasicStats::Moments().min(), 0.0);
+}
+
+TEST(BasicStatsTests, DatasetCachesAndAppends) {
+	BasicStats::Dataset<int> dataset(std::vector<int>{ 5, 1, 4 });
+	EXPECT_DOUBLE_EQ(dataset.median(), 4.0);
+	dataset.append(2);
+	dataset.append(std::vector<int>{ 6, 3 });
+	std::vector<int> data{ 5, 1, 4, 2, 6, 3 };
+	EXPECT_EQ(dataset.sorted(), (std::vector<int>{ 1, 2, 3, 4, 5, 6 }));
+	EXPECT_DOUBLE_EQ(dataset.median(), BasicStats::median(data));
+	EXPECT_DOUBLE_EQ(dataset.first_quartile(), BasicStats::first_quartile(data));
+	EXPECT_DOUBLE_EQ(dataset.third_quartile(), BasicStats::third_quartile(data));
+	EXPECT_DOUBLE_EQ(dataset.percentile(90), BasicStats::percentile(data, 90));
+	EXPECT_NEAR(dataset.variance(), BasicStats::variance(data), 1e-12);
+	EXPECT_DOUBLE_EQ(dataset.range(), 5.0);
+	EXPECT_DOUBLE_EQ(BasicStats::Dataset<int>().median(), 0.0);
+}
+
+TEST(BasicStatsTests, SortedInputHints) {
+	std::vector<int> sorted{ 1, 2, 2, 3, 5, 8 };
+	EXPECT_TRUE(BasicStats::is_sorted(sorted));
+	EXPECT_FALSE(BasicStats::is_sorted(std::vector<int>{ 1, 3, 2 }));
+	EXPECT_TRUE(BasicStats::is_sorted(std::vector<int>{}));
+	EXPECT_DOUBLE_EQ(BasicStats::median(BasicStats::assume_sorted, sorted), 2.5);
+	EXPECT_DOUBLE_EQ(BasicStats::first_quartile(BasicStats::assume_sorted, sorted), 2.0);
+	EXPECT_DOUBLE_EQ(BasicStats::third_quartile(BasicStats::assume_sorted, sorted), 5.0);
+	EXPECT_DOUBLE_EQ(BasicStats::iqr(BasicStats::assume_sorted, sorted), 3.0);
+	EXPECT_DOUBLE_EQ(BasicStats::percentile(BasicStats::assume_sorted, sorted, 50), BasicStats::percentile(sorted, 50));
+	EXPECT_THROW(BasicStats::percentile(BasicStats::assume_sorted, sorted, 101), std::out_of_range);
+}
+
+TEST(BasicStatsTests, NearlySortedOrderStatistics) {
+	std::vector<int> data;
+	for (int i = 0; i < 1000; i++) data.push_back(i);
+	std::swap(data[10], data[500]);
+	std::reverse(data.begin() + 700, data.begin() + 800);
+	std::vector<int> expected = data;
+	std::sort(expected.begin(), expected.end());
+	std::vector<int> sorted = data;
+	BasicStats::detail::adaptive_sort(sorted.begin(), sorted.end());
+	EXPECT_EQ(sorted, expected);
+	EXPECT_DOUBLE_EQ(BasicStats::median(data), 499.5);
+	EXPECT_DOUBLE_EQ(BasicStats::percentile(data, 90), BasicStats::percentile(BasicStats::assume_sorted, expected, 90));
+}
+
+TEST(BasicStatsTests, OrderStatisticTreeMatchesPercentile) {
+	BasicStats::OrderStatisticTree<int> tree;
+	std::vector<int> live;
+	std::mt19937 gen(11);
+	for (int i = 0; i < 5000; i++) {
+		if (!live.empty() && gen() % 3 == 0) {
+			size_t victim = gen() % live.size();
+			EXPECT_TRUE(tree.erase(live[victim]));
+			live.erase(live.begin() + victim);
+		}
+		else {
+			int value = static_cast<int>(gen() % 1000);
+			tree.insert(value);
+			live.push_back(value);
+		}
+	}
+	ASSERT_EQ(tree.size(), live.size());
+	std::vector<int> sorted = live;
+	std::sort(sorted.begin(), sorted.end());
+	EXPECT_EQ(tree.select(0), sorted.front());
+	EXPECT_EQ(tree.select(sorted.size() - 1), sorted.back());
+	EXPECT_EQ(tree.rank(500), static_cast<size_t>(std::lower_bound(sorted.begin(), sorted.end(), 500) - sorted.begin()));
+	for (double p : { 0.0, 50.0, 99.0, 100.0 }) {
+		EXPECT_DOUBLE_EQ(tree.percentile(p), BasicStats::percentile(live, p));
+	}
+	EXPECT_FALSE(tree.erase(5000));
+	EXPECT_THROW(tree.select(live.size()), std::out_of_range);
+	EXPECT_DOUBLE_EQ(BasicStats::OrderStatisticTree<int>().median(), 0.0);
+}
+
+TEST(BasicStatsTests, MergedPercentileAcrossShards) {
+	std::vector<std::vector<int>> shards(5);
+	std::vector<int> all;
+	std::mt19937 gen(3);
+	for (size_t s = 0; s < shards.size(); s++) {
+		for (size_t i = 0; i < 100 * s + 7; i++) shards[s].push_back(static_cast<int>(gen() % 500));
+		std::sort(shards[s].begin(), shards[s].end());
+		all.insert(all.end(), shards[s].begin(), shards[s].end());
+	}
+	shards.push_back({});
+	for (double p : { 0.0, 1.0, 25.0, 50.0, 75.0, 99.9, 100.0 }) {
+		EXPECT_DOUBLE_EQ(BasicStats::merged_percentile(shards, p), BasicStats::percentile(all, p));
+	}
+	EXPECT_DOUBLE_EQ(BasicStats::merged_median(shards), BasicStats::median(all));
+	std::vector<BasicStats::span<const int>> views(shards.begin(), shards.end());
+	std::sort(all.begin(), all.end());
+	EXPECT_EQ(BasicStats::merged_kth_smallest(views, 123), all[123]);
+	EXPECT_THROW(BasicStats::merged_kth_smallest(views, all.size()), std::out_of_range);
+	EXPECT_DOUBLE_EQ(BasicStats::merged_percentile(std::vector<std::vector<int>>{}, 50), 0.0);
+}
+
+TEST(BasicStatsTests, KllSketchRankError) {
+	std::vector<double> data;
+	std::mt19937 gen(5);
+	std::normal_distribution<double> dist(100.0, 15.0);
+	BasicStats::KllSketch left, right;
+	for (int i = 0; i < 100000; i++) {
+		double value = dist(gen);
+		data.push_back(value);
+		(i % 2 == 0 ? left : right).push(value);
+	}
+	left.merge(right);
+	EXPECT_EQ(left.count(), data.size());
+	EXPECT_LT(left.retained(), 2000u);
+	std::sort(data.begin(), data.end());
+	for (double p : { 1.0, 10.0, 50.0, 90.0, 99.0 }) {
+		double estimate = left.percentile(p);
+		double true_rank = static_cast<double>(std::upper_bound(data.begin(), data.end(), estimate) - data.begin()) / data.size();
+		EXPECT_NEAR(true_rank, p / 100, 0.0165);
+	}
+	EXPECT_DOUBLE_EQ(left.percentile(0), data.front());
+	EXPECT_DOUBLE_EQ(left.percentile(100), data.back());
+}
+
+TEST(BasicStatsTests, KllSketchRejectsNaN) {
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	BasicStats::KllSketch clean, mixed;
+	for (int i = 0; i < 1000; i++) {
+		clean.push(i);
+		mixed.push(i);
+		if (i % 8 == 0) mixed.push(nan);
+	}
+	EXPECT_EQ(mixed.count(), 1000u);
+	EXPECT_EQ(mixed.nans(), 125u);
+	EXPECT_EQ(mixed.min(), 0.0);
+	EXPECT_EQ(mixed.max(), 999.0);
+	for (double p : { 1.0, 50.0, 99.0 }) EXPECT_EQ(mixed.percentile(p), clean.percentile(p));
+
+	BasicStats::KllSketch other;
+	other.push(nan);
+	mixed.merge(other);
+	EXPECT_EQ(mixed.nans(), 126u);
+	EXPECT_EQ(mixed.count(), 1000u);
+	BasicStats::KllSketch restored = BasicStats::deserialize<BasicStats::KllSketch>(BasicStats::serialize(mixed));
+	EXPECT_EQ(restored.nans(), 126u);
+	EXPECT_EQ(restored.percentile(50), mixed.percentile(50));
+	mixed.clear();
+	EXPECT_EQ(mixed.nans(), 0u);
+}
+
+TEST(BasicStatsTests, SlidingWindowQuantilesExpire) {
+	BasicStats::SlidingWindowQuantiles window(4, 10);
+	for (int t = 0; t < 40; t++) window.push(t, 1000.0 + t);
+	EXPECT_EQ(window.count(), 40u);
+	window.push(45, 1.0);
+	EXPECT_EQ(window.count(), 31u);
+	EXPECT_DOUBLE_EQ(window.percentile(0), 1.0);
+	window.push(5, 2.0);
+	EXPECT_EQ(window.dropped(), 1u);
+	window.advance(100);
+	EXPECT_EQ(window.count(), 0u);
+	EXPECT_DOUBLE_EQ(window.percentile(50), 0.0);
+	EXPECT_THROW(BasicStats::SlidingWindowQuantiles(0, 10), std::invalid_argument);
+}
+
+TEST(BasicStatsTests, HistogramMergeAndPercentile) {
+	BasicStats::Histogram left(0.0, 10.0, 10), right(0.0, 10.0, 10);
+	for (int i = 0; i < 100; i++) (i % 2 == 0 ? left : right).push(i / 10.0);
+	right.push(-1.0);
+	right.push(20.0);
+	left.merge(right);
+	EXPECT_EQ(left.count(), 102u);
+	EXPECT_EQ(left.underflow(), 1u);
+	EXPECT_EQ(left.overflow(), 1u);
+	EXPECT_EQ(left.counts()[3], 10u);
+	EXPECT_NEAR(left.percentile(50), 5.0, 0.1);
+	EXPECT_THROW(left.merge(BasicStats::Histogram(0.0, 5.0, 10)), std::invalid_argument);
+}
+
+TEST(BasicStatsTests, RollupStorePromotesAndQueries) {
+	BasicStats::RollupStore<> store({ { 1, 60 }, { 60, 60 }, { 3600, 24 } });
+	for (int64_t t = 0; t < 7200; t++) store.push(t, static_cast<double>(t % 60));
+	BasicStats::Moments all = store.query(0, 7200);
+	EXPECT_EQ(all.count(), 7200u);
+	EXPECT_DOUBLE_EQ(all.mean(), 29.5);
+	BasicStats::Moments last_minute = store.query(7140, 7200);
+	EXPECT_EQ(last_minute.count(), 60u);
+	EXPECT_DOUBLE_EQ(last_minute.max(), 59.0);
+	EXPECT_EQ(store.query(3600, 3660).count(), 60u);
+	EXPECT_EQ(store.query(0, 3600).count(), 3600u);
+	store.push(5, 1.0);
+	EXPECT_EQ(store.query(0, 3600).count(), 3601u);
+	EXPECT_THROW(BasicStats::RollupStore<>({ { 2, 10 }, { 3, 10 } }), std::invalid_argument);
+}
+
+TEST(BasicStatsTests, HistogramAndRollupRejectNaN) {
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	BasicStats::Histogram histogram(0.0, 10.0, 10);
+	histogram.push(nan);
+	std::vector<double> batch = { 1.0, nan, 9.5 };
+	histogram.push(batch.data(), batch.size());
+	EXPECT_EQ(histogram.nans(), 2u);
+	EXPECT_EQ(histogram.count(), 2u);
+	EXPECT_EQ(histogram.counts()[9], 1u);
+	EXPECT_EQ(histogram.overflow(), 0u);
+	BasicStats::Histogram copy = BasicStats::deserialize<BasicStats::Histogram>(BasicStats::serialize(histogram));
+	EXPECT_EQ(copy.nans(), 2u);
+	histogram.merge(copy);
+	EXPECT_EQ(histogram.nans(), 4u);
+
+	BasicStats::RollupStore<> store({ { 1, 10 }, { 10, 10 } });
+	store.push(0, 1.0);
+	store.push(0, nan);
+	store.push(1, 3.0);
+	EXPECT_EQ(store.nans(), 1u);
+	EXPECT_DOUBLE_EQ(store.query(0, 10).mean(), 2.0);
+}
+
+TEST(BasicStatsTests, TumblingAndHoppingWindows) {
+	std::vector<int64_t> timestamps{ 0, 3, 1, 12, 7, 15, 2, 25 };
+	std::vector<double> values{ 1, 2, 3, 4, 5, 6, 7, 8 };
+	std::vector<std::tuple<int64_t, int64_t, size_t, double>> emitted;
+	auto record = [&](int64_t start, int64_t end, const BasicStats::Moments& m) { emitted.emplace_back(start, end, m.count(), m.sum()); };
+	size_t dropped = BasicStats::aggregate_windows(timestamps, values, BasicStats::WindowSpec::tumbling(10), 5, record);
+	EXPECT_EQ(dropped, 1u);
+	ASSERT_EQ(emitted.size(), 3u);
+	EXPECT_EQ(emitted[0], std::make_tuple(int64_t(0), int64_t(10), size_t(4), 11.0));
+	EXPECT_EQ(emitted[1], std::make_tuple(int64_t(10), int64_t(20), size_t(2), 10.0));
+	EXPECT_EQ(emitted[2], std::make_tuple(int64_t(20), int64_t(30), size_t(1), 8.0));
+
+	emitted.clear();
+	BasicStats::aggregate_windows(std::vector<int64_t>{ 0, 5, 10 }, std::vector<int>{ 1, 2, 3 }, BasicStats::WindowSpec::hopping(10, 5), 0, record);
+	ASSERT_EQ(emitted.size(), 4u);
+	EXPECT_EQ(emitted[0], std::make_tuple(int64_t(-5), int64_t(5), size_t(1), 1.0));
+	EXPECT_EQ(emitted[1], std::make_tuple(int64_t(0), int64_t(10), size_t(2), 3.0));
+	EXPECT_EQ(emitted[2], std::make_tuple(int64_t(5), int64_t(15), size_t(2), 5.0));
+	EXPECT_THROW(BasicStats::WindowAggregator<>(BasicStats::WindowSpec::hopping(5, 10), 0, record), std::invalid_argument);
+}
+
+TEST(BasicStatsTests, SessionWindowsMergeOutOfOrder) {
+	std::vector<std::pair<int64_t, int64_t>> sessions;
+	std::vector<size_t> counts;
+	BasicStats::WindowAggregator<> aggregator(BasicStats::WindowSpec::session(5), 10,
+		[&](int64_t start, int64_t end, const BasicStats::Moments& m) { sessions.emplace_back(start, end); counts.push_back(m.count()); });
+	for (int64_t t : { 0, 2, 10, 12, 6, 40 }) aggregator.push(t, 1.0);
+	aggregator.flush();
+	ASSERT_EQ(sessions.size(), 2u);
+	EXPECT_EQ(sessions[0], std::make_pair(int64_t(0), int64_t(17)));
+	EXPECT_EQ(counts[0], 5u);
+	EXPECT_EQ(sessions[1], std::make_pair(int64_t(40), int64_t(45)));
+}
+
+TEST(BasicStatsTests, SessionWindowsIndependentOfArrivalOrder) {
+	auto sessions_of = [](std::vector<int64_t> timestamps) {
+		std::vector<std::pair<int64_t, int64_t>> sessions;
+		BasicStats::WindowAggregator<> aggregator(BasicStats::WindowSpec::session(10), 100,
+			[&](int64_t start, int64_t end, const BasicStats::Moments&) { sessions.emplace_back(start, end); });
+		for (int64_t t : timestamps) aggregator.push(t, 1.0);
+		aggregator.flush();
+		std::sort(sessions.begin(), sessions.end());
+		return sessions;
+	};
+	// Points exactly gap apart never share a session, whichever arrives first.
+	std::vector<std::pair<int64_t, int64_t>> apart = { { 0, 10 }, { 10, 20 } };
+	EXPECT_EQ(sessions_of({ 0, 10 }), apart);
+	EXPECT_EQ(sessions_of({ 10, 0 }), apart);
+	std::vector<std::pair<int64_t, int64_t>> joined = { { 0, 19 } };
+	EXPECT_EQ(sessions_of({ 0, 9 }), joined);
+	EXPECT_EQ(sessions_of({ 9, 0 }), joined);
+	EXPECT_EQ(sessions_of({ 0, 20, 10 }), sessions_of({ 10, 20, 0 }));
+}
+
+TEST(BasicStatsTests, ConcurrentRecorderSnapshots) {
+	BasicStats::ConcurrentRecorder<> recorder;
+	constexpr int threads = 4;
+	constexpr int per_thread = 20000;
+	std::atomic<bool> go{ false };
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&recorder, &go]() {
+			auto writer = recorder.writer();
+			while (!go.load()) std::this_thread::yield();
+			for (int i = 1; i <= per_thread; i++) writer.record(static_cast<double>(i));
+		});
+	}
+	go.store(true);
+	BasicStats::Moments total;
+	for (int i = 0; i < 20; i++) total.merge(recorder.snapshot());
+	for (std::thread& worker : workers) worker.join();
+	total.merge(recorder.snapshot());
+	EXPECT_EQ(total.count(), static_cast<size_t>(threads * per_thread));
+	EXPECT_DOUBLE_EQ(total.mean(), (per_thread + 1) / 2.0);
+	EXPECT_DOUBLE_EQ(total.max(), per_thread);
+	EXPECT_EQ(recorder.snapshot().count(), 0u);
+}
+
+TEST(BasicStatsTests, SpscRingBatches) {
+	BasicStats::SpscRing<int> ring(5);
+	EXPECT_EQ(ring.capacity(), 8u);
+	for (int i = 0; i < 8; i++) EXPECT_TRUE(ring.try_push(i));
+	EXPECT_FALSE(ring.try_push(8));
+	int out[16];
+	EXPECT_EQ(ring.try_pop_batch(out, 3), 3u);
+	EXPECT_EQ(out[2], 2);
+	EXPECT_EQ(ring.size(), 5u);
+	EXPECT_EQ(ring.try_pop_batch(out, 16), 5u);
+	EXPECT_EQ(out[4], 7);
+}
+
+TEST(BasicStatsTests, IngestAggregatorPolicies) {
+	{
+		BasicStats::IngestAggregator<> aggregator(1024, BasicStats::BackPressure::block);
+		std::vector<std::thread> producers;
+		for (int t = 0; t < 4; t++) {
+			producers.emplace_back([&aggregator]() { for (int i = 0; i < 10000; i++) aggregator.push(2.0); });
+		}
+		for (std::thread& producer : producers) producer.join();
+		aggregator.flush();
+		BasicStats::Moments result = aggregator.snapshot();
+		EXPECT_EQ(result.count(), 40000u);
+		EXPECT_DOUBLE_EQ(result.mean(), 2.0);
+		EXPECT_EQ(aggregator.dropped(), 0u);
+	}
+	{
+		BasicStats::IngestAggregator<BasicStats::Moments, BasicStats::MpscRing<double>> aggregator(16, BasicStats::BackPressure::overwrite);
+		for (int i = 0; i < 100000; i++) aggregator.push(1.0);
+		aggregator.stop();
+		EXPECT_EQ(aggregator.processed() + aggregator.overwritten(), 100000u);
+	}
+	{
+		BasicStats::IngestAggregator<BasicStats::Moments, BasicStats::SpscRing<double>> aggregator(16, BasicStats::BackPressure::drop);
+		for (int i = 0; i < 100000; i++) aggregator.push(1.0);
+		aggregator.stop();
+		EXPECT_EQ(aggregator.processed() + aggregator.dropped(), 100000u);
+		EXPECT_EQ(aggregator.snapshot().count(), aggregator.processed());
+	}
+	{
+		// After stop() nothing drains the ring: a blocking push must give up and flush must return.
+		BasicStats::IngestAggregator<BasicStats::Moments, BasicStats::SpscRing<double>> aggregator(4, BasicStats::BackPressure::block);
+		aggregator.stop();
+		size_t accepted = 0;
+		for (int i = 0; i < 8; i++) accepted += aggregator.push(1.0);
+		EXPECT_EQ(accepted, 4u);
+		EXPECT_EQ(aggregator.dropped(), 4u);
+		EXPECT_EQ(aggregator.depth(), 4u);
+		aggregator.flush();
+		EXPECT_EQ(aggregator.snapshot().count(), 0u);
+	}
+	using SpscIngest = BasicStats::IngestAggregator<BasicStats::Moments, BasicStats::SpscRing<double>>;
+	EXPECT_THROW(SpscIngest(16, BasicStats::BackPressure::overwrite), std::invalid_argument);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST(BasicStatsTests, SharedStatsSeqlockRoundTrip) {
+	std::string name = "/basicstats_test_" + std::to_string(::getpid());
+	BasicStats::SharedStatsPublisher publisher(name, 16);
+	BasicStats::SharedStatsReader reader(name);
+	BasicStats::Moments moments;
+	moments.push(std::vector<double>{ 1.0, 2.0, 3.0 });
+	BasicStats::Histogram histogram(0.0, 4.0, 4);
+	histogram.push(std::vector<double>{ 1.0, 2.0, 3.0 }.data(), 3);
+	histogram.push(std::numeric_limits<double>::quiet_NaN());
+	publisher.publish(moments, &histogram);
+	BasicStats::PublishedStats stats = reader.read();
+	EXPECT_EQ(stats.generation, 1u);
+	EXPECT_EQ(stats.moments.count(), 3u);
+	EXPECT_DOUBLE_EQ(stats.moments.variance(), moments.variance());
+	ASSERT_TRUE(stats.has_histogram);
+	EXPECT_EQ(stats.histogram.counts(), histogram.counts());
+	EXPECT_EQ(stats.histogram.nans(), 1u);
+	BasicStats::Histogram too_wide(0.0, 1.0, 17);
+	EXPECT_THROW(publisher.publish(moments, &too_wide), std::invalid_argument);
+
+	std::atomic<bool> done{ false };
+	std::thread writer([&]() {
+		for (int i = 1; i <= 20000; i++) publisher.publish(BasicStats::Moments(i, i, 0.0, i, i));
+		done.store(true);
+	});
+	bool consistent = true;
+	while (!done.load()) {
+		BasicStats::PublishedStats s = reader.read();
+		consistent &= s.generation == 1 || (s.moments.mean() == static_cast<double>(s.moments.count()) && s.moments.max() == s.moments.mean());
+	}
+	writer.join();
+	EXPECT_TRUE(consistent);
+	EXPECT_EQ(reader.read().moments.count(), 20000u);
+
+	// A new, smaller publisher replaces the segment instead of truncating or zeroing the one still mapped.
+	{
+		BasicStats::SharedStatsPublisher replacement(name, 1);
+		BasicStats::PublishedStats stale = reader.read();
+		EXPECT_EQ(stale.moments.count(), 20000u);
+		EXPECT_EQ(stale.generation, 20001u);
+		BasicStats::SharedStatsReader fresh(name);
+		replacement.publish(moments);
+		EXPECT_EQ(fresh.read().moments.count(), 3u);
+		EXPECT_EQ(reader.read().moments.count(), 20000u);
+	}
+	BasicStats::SharedStatsPublisher::unlink(name);
+	EXPECT_THROW(BasicStats::SharedStatsReader("/basicstats_missing_segment"), std::runtime_error);
+}
+#endif
+
+TEST(BasicStatsTests, SerializationRoundTrip) {
+	std::mt19937 gen(64);
+	std::normal_distribution<double> dist(0.5, 0.15);
+	BasicStats::Moments moments;
+	BasicStats::Histogram histogram(0.0, 1.0, 128);
+	BasicStats::KllSketch sketch(64);
+	for (int i = 0; i < 50000; i++) {
+		double x = dist(gen);
+		moments.push(x);
+		histogram.push(x);
+		sketch.push(x);
+	}
+
+	std::vector<uint8_t> bytes = BasicStats::serialize(moments);
+	BasicStats::Moments m = BasicStats::deserialize<BasicStats::Moments>(bytes);
+	EXPECT_EQ(m.count(), moments.count());
+	EXPECT_EQ(m.mean(), moments.mean());
+	EXPECT_EQ(m.variance(), moments.variance());
+	EXPECT_EQ(m.max(), moments.max());
+
+	bytes = BasicStats::serialize(histogram);
+	EXPECT_LT(bytes.size(), 128u * 3);
+	EXPECT_EQ(BasicStats::serialized_type(bytes), BasicStats::SerializedType::histogram);
+	BasicStats::Histogram h = BasicStats::deserialize<BasicStats::Histogram>(bytes);
+	EXPECT_EQ(h.counts(), histogram.counts());
+	EXPECT_EQ(h.overflow(), histogram.overflow());
+
+	bytes = BasicStats::serialize(sketch);
+	BasicStats::KllSketch s = BasicStats::deserialize<BasicStats::KllSketch>(bytes);
+	EXPECT_EQ(s.count(), sketch.count());
+	EXPECT_EQ(s.percentile(50), sketch.percentile(50));
+	s.merge(sketch);
+	EXPECT_EQ(s.count(), 2 * sketch.count());
+
+	std::vector<double> data = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+	auto mean_func = [](const std::vector<double>& d) { return BasicStats::mean(d); };
+	BasicStats::BootstrapReplicates replicates = BasicStats::bootstrap_replicates(data, mean_func, 256);
+	BasicStats::BootstrapReplicates merged = BasicStats::deserialize<BasicStats::BootstrapReplicates>(BasicStats::serialize(replicates));
+	merged.merge(replicates);
+	EXPECT_EQ(merged.count(), 512u);
+	std::pair<double, double> ci = merged.confidence_interval(95);
+	EXPECT_LE(ci.first, 3.0);
+	EXPECT_GE(ci.second, 3.0);
+
+	bytes = BasicStats::serialize(moments);
+	EXPECT_THROW(BasicStats::deserialize<BasicStats::Histogram>(bytes), std::invalid_argument);
+	bytes.pop_back();
+	EXPECT_THROW(BasicStats::deserialize<BasicStats::Moments>(bytes), std::invalid_argument);
+	bytes = BasicStats::serialize(moments);
+	bytes[3] = 99;
+	EXPECT_THROW(BasicStats::deserialize<BasicStats::Moments>(bytes), std::invalid_argument);
+}
+
+TEST(BasicStatsTests, TreeMergeMatchesSerialFold) {
+	std::mt19937 gen(65);
+	std::normal_distribution<double> dist(1000.0, 2.0);
+	std::vector<BasicStats::Moments> parts(1000);
+	std::vector<BasicStats::Histogram> histograms(1000, BasicStats::Histogram(990.0, 1010.0, 40));
+	std::vector<double> all;
+	for (size_t i = 0; i < parts.size(); i++) {
+		for (int j = 0; j < 7; j++) {
+			double x = dist(gen);
+			parts[i].push(x);
+			histograms[i].push(x);
+			all.push_back(x);
+		}
+	}
+	BasicStats::Moments merged = BasicStats::tree_merge(parts, 16);
+	EXPECT_EQ(merged.count(), all.size());
+	EXPECT_NEAR(merged.mean(), BasicStats::mean(all), 1e-9);
+	EXPECT_NEAR(merged.variance(), BasicStats::variance(all), 1e-9);
+	EXPECT_EQ(merged.min(), *std::min_element(all.begin(), all.end()));
+
+	BasicStats::Histogram folded = histograms[0];
+	for (size_t i = 1; i < histograms.size(); i++) folded.merge(histograms[i]);
+	EXPECT_EQ(BasicStats::tree_merge(histograms, 16).counts(), folded.counts());
+
+	std::vector<std::vector<uint8_t>> encoded;
+	for (const BasicStats::Moments& part : parts) encoded.push_back(BasicStats::serialize(part));
+	BasicStats::Moments decoded = BasicStats::tree_merge_serialized<BasicStats::Moments>(encoded, 16);
+	EXPECT_EQ(decoded.count(), merged.count());
+	EXPECT_DOUBLE_EQ(decoded.variance(), merged.variance());
+
+	EXPECT_EQ(BasicStats::tree_merge(std::vector<BasicStats::Moments>()).count(), 0u);
+}
+
+TEST(BasicStatsTests, ExecutorSchedulesParallelAlgorithms) {
+	struct CountingExecutor : BasicStats::Executor {
+		BasicStats::ThreadPool pool{ 4 };
+		std::atomic<size_t> tasks{ 0 };
+		size_t concurrency() const override { return pool.concurrency(); }
+		void execute(std::function<void()> task, size_t hint) override {
+			++tasks;
+			pool.execute(std::move(task), hint);
+		}
+	};
+	auto executor = std::make_shared<CountingExecutor>();
+	BasicStats::set_default_executor(executor);
+	size_t sort_grain = BasicStats::grain_size(BasicStats::ParallelAlgorithm::sort);
+	BasicStats::set_grain_size(BasicStats::ParallelAlgorithm::sort, 100);
+
+	std::mt19937 gen(66);
+	std::vector<int> data(10007);
+	for (int& x : data) x = static_cast<int>(gen() % 1000);
+	std::vector<int> expected = data;
+	std::sort(expected.begin(), expected.end());
+	std::vector<int> sorted = data;
+	BasicStats::detail::parallel_sort(sorted.begin(), sorted.end());
+	EXPECT_EQ(sorted, expected);
+	EXPECT_GT(executor->tasks.load(), 0u);
+
+	std::atomic<size_t> visited{ 0 };
+	BasicStats::detail::parallel_for(64, 1, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; i++)
+			BasicStats::detail::parallel_for(64, 1, [&](size_t b2, size_t e2) { visited += e2 - b2; });
+	});
+	EXPECT_EQ(visited.load(), 64u * 64u);
+	EXPECT_THROW(BasicStats::detail::parallel_for(64, 1, [](size_t b, size_t) {
+		if (b > 0) throw std::runtime_error("chunk failed");
+	}), std::runtime_error);
+
+	BasicStats::set_grain_size(BasicStats::ParallelAlgorithm::sort, sort_grain);
+	BasicStats::set_default_executor(nullptr);
+	EXPECT_NE(BasicStats::default_executor(), executor);
+}
+
+TEST(BasicStatsTests, ConfidenceIntervalParallelOnlyOnRequest) {
+	BasicStats::set_default_executor(std::make_shared<BasicStats::ThreadPool>(4));
+	std::vector<double> data(200);
+	std::iota(data.begin(), data.end(), 0.0);
+
+	// The plain overload calls the caller's functor serially, so unsynchronised state is safe.
+	int calls = 0;
+	std::vector<double> scratch;
+	auto stateful_mean = [&calls, &scratch](const std::vector<double>& sample) {
+		++calls;
+		scratch.assign(sample.begin(), sample.end());
+		return BasicStats::mean(scratch);
+	};
+	std::pair<double, double> ci = BasicStats::confidence_interval(data, stateful_mean, 95, 300);
+	EXPECT_EQ(calls, 300);
+	EXPECT_LT(ci.first, 99.5);
+	EXPECT_GT(ci.second, 99.5);
+
+	// The parallel overload gives every task its own copy of the functor.
+	struct ScratchMean {
+		std::vector<double> scratch;
+		std::shared_ptr<std::atomic<int>> calls = std::make_shared<std::atomic<int>>(0);
+		double operator()(const std::vector<double>& sample) {
+			++*calls;
+			scratch.assign(sample.begin(), sample.end());
+			return BasicStats::mean(scratch);
+		}
+	};
+	ScratchMean functor;
+	std::pair<double, double> parallel_ci = BasicStats::confidence_interval(BasicStats::parallel, data, functor, 95, 300);
+	EXPECT_EQ(functor.calls->load(), 300);
+	EXPECT_LT(parallel_ci.first, 99.5);
+	EXPECT_GT(parallel_ci.second, 99.5);
+	BasicStats::set_default_executor(nullptr);
+}
+
+TEST(BasicStatsTests, NumaPlacementAndPerNodeReduction) {
+	EXPECT_EQ(BasicStats::detail::parse_cpu_list("0-3,8,10-11\n"), std::vector<unsigned int>({ 0, 1, 2, 3, 8, 10, 11 }));
+	EXPECT_GE(BasicStats::NumaTopology::detect().nodes(), 1u);
+
+	BasicStats::NumaExecutor executor(BasicStats::NumaTopology::simulated_topology(3, 2));
+	EXPECT_EQ(executor.concurrency(), 6u);
+	std::vector<double> data(5000);
+	std::iota(data.begin(), data.end(), 0.0);
+	BasicStats::NumaArray<double> partitioned(data, BasicStats::NumaPlacement::partitioned, executor);
+	BasicStats::NumaArray<double> interleaved(data, BasicStats::NumaPlacement::interleaved, executor);
+	EXPECT_TRUE(std::equal(partitioned.begin(), partitioned.end(), data.begin()));
+	EXPECT_TRUE(std::equal(interleaved.begin(), interleaved.end(), data.begin()));
+	// 5000 doubles span 10 pages of 512.
+	EXPECT_EQ(partitioned.node_of(0), 0u);
+	EXPECT_EQ(partitioned.node_of(4999), 2u);
+	EXPECT_EQ(interleaved.node_of(512), 1u);
+	EXPECT_EQ(interleaved.node_of(3 * 512), 0u);
+
+	for (const BasicStats::NumaArray<double>* array : { &partitioned, &interleaved }) {
+		BasicStats::Moments moments = BasicStats::reduce_by_node(*array, executor);
+		EXPECT_EQ(moments.count(), data.size());
+		EXPECT_NEAR(moments.mean(), BasicStats::mean(data), 1e-9);
+		EXPECT_NEAR(moments.variance(), BasicStats::variance(data), 1e-6);
+	}
+	BasicStats::NumaExecutor other(BasicStats::NumaTopology::simulated_topology(2, 1));
+	EXPECT_THROW(BasicStats::reduce_by_node(partitioned, other), std::invalid_argument);
+}
+
+TEST(BasicStatsTests, NumaExecutorPlacesChunksWithFewerChunksThanWorkers) {
+	BasicStats::NumaExecutor executor(BasicStats::NumaTopology::simulated_topology(2, 4));
+	ASSERT_EQ(executor.concurrency(), 8u);
+	EXPECT_EQ(executor.node_of_chunk(0, 4), 0u);
+	EXPECT_EQ(executor.node_of_chunk(1, 4), 0u);
+	EXPECT_EQ(executor.node_of_chunk(2, 4), 1u);
+	EXPECT_EQ(executor.node_of_chunk(3, 4), 1u);
+
+	auto pool_running = [](BasicStats::Executor& target, auto submit) {
+		std::promise<const void*> pool;
+		std::future<const void*> result = pool.get_future();
+		submit(target, [&pool]() { pool.set_value(BasicStats::detail::current_pool); });
+		return result.get();
+	};
+	const void* node1 = pool_running(executor, [](BasicStats::Executor& e, std::function<void()> task) {
+		static_cast<BasicStats::NumaExecutor&>(e).execute_on(1, std::move(task));
+	});
+	const void* chunk2 = pool_running(executor, [](BasicStats::Executor& e, std::function<void()> task) {
+		e.execute_chunk(std::move(task), 2, 4);
+	});
+	EXPECT_EQ(chunk2, node1);
+
+	// Node 1 owns the upper half of a partitioned array; its chunks reach node 1's pool.
+	auto shared = std::shared_ptr<BasicStats::NumaExecutor>(&executor, [](BasicStats::NumaExecutor*) {});
+	BasicStats::set_default_executor(shared);
+	std::atomic<size_t> on_node1{ 0 };
+	for (int pass = 0; pass < 20; ++pass)
+		BasicStats::detail::parallel_for(4, 1, [&](size_t, size_t) {
+			if (BasicStats::detail::current_pool == node1) ++on_node1;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		});
+	BasicStats::set_default_executor(nullptr);
+	EXPECT_GT(on_node1.load(), 0u);
+}
+
+TEST(BasicStatsTests, ChunkedConsumptionDrivesAccumulators) {
+	std::vector<double> data(1000);
+	std::iota(data.begin(), data.end(), 0.0);
+	BasicStats::Moments moments;
+	BasicStats::Histogram histogram(0.0, 1000.0, 10);
+	BasicStats::KllSketch sketch;
+	size_t consumed = BasicStats::consume_chunks<double>(BasicStats::chunk_source(BasicStats::span<const double>(data), 64), moments, histogram, sketch);
+	EXPECT_EQ(consumed, data.size());
+	EXPECT_EQ(moments.count(), data.size());
+	EXPECT_DOUBLE_EQ(moments.mean(), 499.5);
+	EXPECT_EQ(histogram.counts()[3], 100u);
+	EXPECT_EQ(sketch.count(), data.size());
+	EXPECT_THROW(BasicStats::chunk_source(BasicStats::span<const double>(data), 0), std::invalid_argument);
+
+#if BASIC_STATS_HAS_COROUTINES
+	BasicStats::Moments from_generator;
+	EXPECT_EQ(BasicStats::consume_chunks(BasicStats::chunks_of(BasicStats::span<const double>(data), 100), from_generator), data.size());
+	EXPECT_DOUBLE_EQ(from_generator.variance(), moments.variance());
+	BasicStats::Moments adapted;
+	auto chunks = BasicStats::as_generator<double>(BasicStats::chunk_source(BasicStats::span<const double>(data), 7));
+	EXPECT_EQ(BasicStats::consume_chunks(std::move(chunks), adapted), data.size());
+	EXPECT_EQ(adapted.max(), 999.0);
+	EXPECT_THROW(BasicStats::consume_chunks(BasicStats::chunks_of(BasicStats::span<const double>(data), 0), adapted), std::invalid_argument);
+#endif
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace {
+	// A file in the temporary directory, removed when the test ends, pass or fail.
+	struct TempFile {
+		std::string path;
+		explicit TempFile(const std::string& name)
+			: path((std::filesystem::temp_directory_path() / (std::to_string(::getpid()) + "_" + name)).string()) {}
+		~TempFile() { std::remove(path.c_str()); }
+	};
+}
+
+TEST(BasicStatsTests, ChunkedFileReaderBackends) {
+	TempFile temp("basicstats_chunked.bin");
+	const std::string& path = temp.path;
+	std::vector<double> data(100003);
+	std::iota(data.begin(), data.end(), 0.0);
+	FILE* file = std::fopen(path.c_str(), "wb");
+	ASSERT_NE(file, nullptr);
+	std::fwrite(data.data(), sizeof(double), data.size(), file);
+	std::fclose(file);
+
+	for (bool use_io_uring : { true, false }) {
+		for (bool direct : { true, false }) {
+			BasicStats::ChunkedReadOptions options;
+			options.buffer_bytes = 16384;
+			options.buffers = 3;
+			options.use_io_uring = use_io_uring;
+			options.direct = direct;
+			BasicStats::ChunkedFileReader<double> reader(path, options);
+			if (!use_io_uring) {
+				EXPECT_EQ(reader.backend(), BasicStats::ReadBackend::pread);
+			}
+			BasicStats::Moments moments;
+			EXPECT_EQ(BasicStats::consume_chunks<double>(reader, moments), data.size());
+			EXPECT_EQ(moments.max(), 100002.0);
+			EXPECT_DOUBLE_EQ(moments.mean(), 50001.0);
+		}
+	}
+	EXPECT_EQ(BasicStats::aggregate_file<double>(path).count(), data.size());
+	BasicStats::ChunkedReadOptions unaligned;
+	unaligned.buffer_bytes = 1000;
+	EXPECT_THROW(BasicStats::ChunkedFileReader<double>(path, unaligned), std::invalid_argument);
+	std::remove(path.c_str());
+	EXPECT_THROW(BasicStats::ChunkedFileReader<double>{ path }, std::runtime_error);
+}
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST(BasicStatsTests, ColumnFileZoneMapsSkipBlocks) {
+	TempFile temp("basicstats_column.bscf");
+	const std::string& path = temp.path;
+	std::vector<double> data(10000);
+	std::iota(data.begin(), data.end(), 0.0);
+	BasicStats::write_column_file(path, data, 1000);
+	{
+		BasicStats::ColumnFile<double> file(path);
+		EXPECT_EQ(file.size(), data.size());
+		EXPECT_EQ(file.block_count(), 10u);
+		EXPECT_EQ(file.block(3)[0], 3000.0);
+		EXPECT_EQ(file.zone(9).max, 9999.0);
+		EXPECT_NEAR(file.moments().variance(), BasicStats::variance(data), 1e-6);
+
+		BasicStats::ZoneScan scan;
+		BasicStats::Moments filtered = file.filter_moments(2500.0, 6999.0, &scan);
+		std::vector<double> expected = BasicStats::filter(data, [](double x) { return x >= 2500.0 && x <= 6999.0; });
+		EXPECT_EQ(filtered.count(), expected.size());
+		EXPECT_NEAR(filtered.mean(), BasicStats::mean(expected), 1e-9);
+		EXPECT_NEAR(filtered.variance(), BasicStats::variance(expected), 1e-6);
+		EXPECT_EQ(scan.skipped, 5u);
+		EXPECT_EQ(scan.from_header, 4u);
+		EXPECT_EQ(scan.scanned, 1u);
+		EXPECT_THROW(file.block(10), std::out_of_range);
+		EXPECT_THROW(BasicStats::ColumnFile<float>{ path }, std::runtime_error);
+	}
+
+	// A NaN inside a block that lies wholly in range sends the block to the scan.
+	// The file is replaced by rename, so a view of the old file still reads it intact.
+	BasicStats::ColumnFile<double> previous(path);
+	data[4200] = std::numeric_limits<double>::quiet_NaN();
+	BasicStats::write_column_file(path, data, 1000);
+	EXPECT_EQ(previous.block(4)[200], 4200.0);
+	EXPECT_EQ(previous.zone(4).nans, 0u);
+	{
+		BasicStats::ColumnFile<double> file(path);
+		EXPECT_EQ(file.zone(4).nans, 1u);
+		EXPECT_EQ(file.zone(3).nans, 0u);
+		BasicStats::ZoneScan scan;
+		BasicStats::Moments filtered = file.filter_moments(2500.0, 6999.0, &scan);
+		std::vector<double> expected = BasicStats::filter(data, [](double x) { return x >= 2500.0 && x <= 6999.0; });
+		EXPECT_EQ(filtered.count(), expected.size());
+		EXPECT_NEAR(filtered.mean(), BasicStats::mean(expected), 1e-9);
+		EXPECT_EQ(scan.from_header, 3u);
+		EXPECT_EQ(scan.scanned, 2u);
+	}
+}
+#endif
+
+TEST(BasicStatsTests, CompressedSamplesRoundTrip) {
+	std::vector<double> prices(5000);
+	double price = 100.0;
+	for (size_t i = 0; i < prices.size(); ++i) {
+		price += (i % 7 == 0) ? 0.25 : (i % 3 == 0 ? -0.125 : 0.0);
+		prices[i] = price;
+	}
+	BasicStats::CompressedSamples<double> samples(512);
+	samples.push(prices.data(), prices.size());
+	EXPECT_EQ(samples.size(), prices.size());
+	EXPECT_EQ(samples.block_count(), 10u);
+	EXPECT_LT(samples.bytes(), prices.size() * sizeof(double));
+	EXPECT_EQ(samples.to_vector(), prices);
+	EXPECT_NEAR(samples.moments().variance(), BasicStats::variance(prices), 1e-6);
+	EXPECT_EQ(samples.aggregate<BasicStats::Moments>().count(), prices.size());
+	for (double p : { 0.0, 25.0, 50.0, 99.9, 100.0 })
+		EXPECT_DOUBLE_EQ(samples.percentile(p), BasicStats::percentile(prices, p));
+
+	std::vector<int64_t> timestamps(16384);
+	for (size_t i = 0; i < timestamps.size(); ++i)
+		timestamps[i] = 1700000000000 + static_cast<int64_t>(i) * 1000 + (i % 5 == 0 ? 3 : 0);
+	BasicStats::CompressedSamples<int64_t> stamps(1024);
+	stamps.push(timestamps.data(), timestamps.size());
+	EXPECT_EQ(stamps.to_vector(), timestamps);
+	EXPECT_LT(stamps.bytes() * 4, timestamps.size() * sizeof(int64_t));
+	EXPECT_EQ(stamps.zone(1).min, static_cast<double>(timestamps[1024]));
+	EXPECT_THROW(stamps.zone(16), std::out_of_range);
+
+	// NaN values have no rank: percentiles match those of the values without them.
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	std::vector<double> gappy = { nan, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, nan, 1.0, nan };
+	BasicStats::CompressedSamples<double> with_nan(4);
+	with_nan.push(gappy.data(), gappy.size());
+	EXPECT_EQ(with_nan.zone(0).nans, 1u);
+	std::vector<double> clean = { 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0 };
+	for (double p : { 0.0, 10.0, 50.0, 90.0, 100.0 })
+		EXPECT_DOUBLE_EQ(with_nan.percentile(p), BasicStats::percentile(clean, p));
+	BasicStats::CompressedSamples<double> only_nan(4);
+	only_nan.push(nan);
+	EXPECT_EQ(only_nan.percentile(50), 0.0);
+}
+
+TEST(BasicStatsTests, NanPoliciesAndValidityBitmaps) {
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	std::vector<double> data = { 4.0, nan, 1.0, 3.0, nan, 2.0 };
+	std::vector<double> clean = { 4.0, 1.0, 3.0, 2.0 };
+	EXPECT_TRUE(std::isnan(BasicStats::sum(data, BasicStats::NanPolicy::propagate)));
+	EXPECT_TRUE(std::isnan(BasicStats::median(data, BasicStats::NanPolicy::propagate)));
+	EXPECT_THROW(BasicStats::mean(data, BasicStats::NanPolicy::error), std::invalid_argument);
+	EXPECT_THROW(BasicStats::percentile(data, 50.0, BasicStats::NanPolicy::error), std::invalid_argument);
+	EXPECT_DOUBLE_EQ(BasicStats::sum(data, BasicStats::NanPolicy::skip), 10.0);
+	EXPECT_DOUBLE_EQ(BasicStats::mean(data, BasicStats::NanPolicy::skip), 2.5);
+	EXPECT_DOUBLE_EQ(BasicStats::variance(data, BasicStats::NanPolicy::skip), BasicStats::variance(clean));
+	EXPECT_DOUBLE_EQ(BasicStats::median(data, BasicStats::NanPolicy::skip), 2.5);
+	EXPECT_DOUBLE_EQ(BasicStats::percentile(data, 75.0, BasicStats::NanPolicy::skip), BasicStats::percentile(clean, 75.0));
+	EXPECT_DOUBLE_EQ(BasicStats::mean(clean, BasicStats::NanPolicy::error), 2.5);
+	EXPECT_DOUBLE_EQ(BasicStats::first_quartile(data, BasicStats::NanPolicy::skip), BasicStats::first_quartile(clean));
+	EXPECT_DOUBLE_EQ(BasicStats::third_quartile(data, BasicStats::NanPolicy::skip), BasicStats::third_quartile(clean));
+	EXPECT_DOUBLE_EQ(BasicStats::iqr(data, BasicStats::NanPolicy::skip), BasicStats::iqr(clean));
+	EXPECT_DOUBLE_EQ(BasicStats::range(data, BasicStats::NanPolicy::skip), 3.0);
+	EXPECT_DOUBLE_EQ(BasicStats::geo_mean(data, BasicStats::NanPolicy::skip), BasicStats::geo_mean(clean));
+	EXPECT_DOUBLE_EQ(BasicStats::coeff_of_variation(data, BasicStats::NanPolicy::skip), BasicStats::coeff_of_variation(clean));
+	EXPECT_TRUE(std::isnan(BasicStats::range(data, BasicStats::NanPolicy::propagate)));
+	EXPECT_TRUE(std::isnan(BasicStats::iqr(data, BasicStats::NanPolicy::propagate)));
+	EXPECT_THROW(BasicStats::first_quartile(data, BasicStats::NanPolicy::error), std::invalid_argument);
+	EXPECT_THROW(BasicStats::geo_mean(data, BasicStats::NanPolicy::error), std::invalid_argument);
+	EXPECT_EQ(BasicStats::coeff_of_variation(std::vector<double>{ nan }, BasicStats::NanPolicy::skip), 0.0);
+
+	// Bits 1 and 4 mark the NaN slots as missing; bit 5 also drops the trailing 2.0.
+	std::vector<uint8_t> validity = { 0x0D };
+	EXPECT_DOUBLE_EQ(BasicStats::sum(data, validity), 8.0);
+	EXPECT_DOUBLE_EQ(BasicStats::median(data, validity), 3.0);
+	EXPECT_DOUBLE_EQ(BasicStats::stdev(data, validity), BasicStats::stdev(std::vector<double>{ 4.0, 1.0, 3.0 }));
+	std::vector<double> present = { 4.0, 1.0, 3.0 };
+	EXPECT_DOUBLE_EQ(BasicStats::range(data, validity), 3.0);
+	EXPECT_DOUBLE_EQ(BasicStats::geo_mean(data, validity), BasicStats::geo_mean(present));
+	EXPECT_DOUBLE_EQ(BasicStats::coeff_of_variation(data, validity), BasicStats::coeff_of_variation(present));
+	EXPECT_DOUBLE_EQ(BasicStats::first_quartile(data, validity), BasicStats::first_quartile(present));
+	EXPECT_DOUBLE_EQ(BasicStats::third_quartile(data, validity), BasicStats::third_quartile(present));
+	EXPECT_DOUBLE_EQ(BasicStats::iqr(data, validity), BasicStats::iqr(present));
+	validity[0] |= 0x10;
+	EXPECT_TRUE(std::isnan(BasicStats::mean(data, validity)));
+	EXPECT_DOUBLE_EQ(BasicStats::mean(data, validity, BasicStats::NanPolicy::skip), 8.0 / 3.0);
+	EXPECT_TRUE(std::isnan(BasicStats::third_quartile(data, validity)));
+	EXPECT_DOUBLE_EQ(BasicStats::range(data, validity, BasicStats::NanPolicy::skip), 3.0);
+
+	std::vector<int> large(5000);
+	std::iota(large.begin(), large.end(), 0);
+	std::vector<uint8_t> even((large.size() + 7) / 8, 0x55);
+	EXPECT_DOUBLE_EQ(BasicStats::sum(large, even), 2500.0 * 4998.0 / 2.0);
+	EXPECT_DOUBLE_EQ(BasicStats::percentile(large, even, 100.0), 4998.0);
+	EXPECT_THROW(BasicStats::sum(large, BasicStats::span<const uint8_t>(even.data(), 10)), std::invalid_argument);
+}
+
+namespace {
+	struct Request {
+		double latency;
+		uint64_t bytes;
+		int status;
+	};
+}
+
+TEST(BasicStatsTests, ProjectionsAndStridedViews) {
+	std::vector<Request> requests;
+	std::vector<double> latencies;
+	std::vector<uint64_t> sizes;
+	for (int i = 0; i < 3001; ++i) {
+		requests.push_back({ (i * 37 % 1000) / 10.0, static_cast<uint64_t>(i * 3), i % 5 == 0 ? 500 : 200 });
+		latencies.push_back(requests.back().latency);
+		sizes.push_back(requests.back().bytes);
+	}
+	EXPECT_DOUBLE_EQ(BasicStats::mean(requests, &Request::latency), BasicStats::mean(latencies));
+	EXPECT_NEAR(BasicStats::variance(requests, &Request::latency), BasicStats::variance(latencies), 1e-9);
+	EXPECT_DOUBLE_EQ(BasicStats::median(requests, &Request::latency), BasicStats::median(latencies));
+	EXPECT_DOUBLE_EQ(BasicStats::percentile(requests, &Request::latency, 90.0), BasicStats::percentile(latencies, 90.0));
+	EXPECT_DOUBLE_EQ(BasicStats::sum(requests, &Request::bytes), BasicStats::sum(sizes));
+	EXPECT_DOUBLE_EQ(BasicStats::range(requests, &Request::bytes), 9000.0);
+	EXPECT_DOUBLE_EQ(BasicStats::mean(requests, [](const Request& r) { return r.status == 500 ? 1.0 : 0.0; }), 601.0 / 3001.0);
+	EXPECT_DOUBLE_EQ(BasicStats::stdev(requests, [](const Request& r) { return r.latency; }), BasicStats::stdev(requests, &Request::latency));
+
+	BasicStats::strided_span<const double> view = BasicStats::project(requests, &Request::latency);
+	EXPECT_EQ(view.size(), requests.size());
+	EXPECT_EQ(view.stride(), sizeof(Request));
+	EXPECT_EQ(view[7], requests[7].latency);
+	std::vector<double> interleaved = { 1.0, -1.0, 2.0, -2.0, 3.0, -3.0, 4.0, -4.0 };
+	BasicStats::strided_span<const double> evens(interleaved.data(), 4, 2 * sizeof(double));
+	EXPECT_DOUBLE_EQ(BasicStats::sum(evens), 10.0);
+	EXPECT_DOUBLE_EQ(BasicStats::median(evens), 2.5);
+	EXPECT_DOUBLE_EQ(BasicStats::mean(BasicStats::strided_span<const double>(interleaved)), 0.0);
+	EXPECT_THROW(BasicStats::strided_span<const double>(interleaved.data(), 2, 4), std::invalid_argument);
+	EXPECT_EQ(BasicStats::mean(std::vector<Request>(), &Request::latency), 0.0);
+
+	EXPECT_DOUBLE_EQ(BasicStats::first_quartile(requests, &Request::latency), BasicStats::first_quartile(latencies));
+	EXPECT_DOUBLE_EQ(BasicStats::third_quartile(requests, &Request::latency), BasicStats::third_quartile(latencies));
+	EXPECT_DOUBLE_EQ(BasicStats::iqr(requests, &Request::latency), BasicStats::iqr(latencies));
+	EXPECT_NEAR(BasicStats::coeff_of_variation(requests, &Request::latency), BasicStats::coeff_of_variation(latencies), 1e-9);
+	EXPECT_DOUBLE_EQ(BasicStats::iqr(view), BasicStats::iqr(latencies));
+	EXPECT_DOUBLE_EQ(BasicStats::geo_mean(evens), std::pow(24.0, 0.25));
+	std::vector<Request> first_ten(requests.begin(), requests.begin() + 10);
+	EXPECT_DOUBLE_EQ(BasicStats::geo_mean(first_ten, [](const Request& r) { return r.status / 100.0; }), std::pow(5.0, 0.2) * std::pow(2.0, 0.8));
+	EXPECT_DOUBLE_EQ(BasicStats::first_quartile(evens), 1.5);
+	EXPECT_DOUBLE_EQ(BasicStats::third_quartile(evens), 3.5);
+
+	// A column of a mutable matrix is a mutable strided view; the reductions take it as is.
+	std::vector<double> cells = { 1.0, 10.0, 2.0, 20.0, 3.0, 30.0 };
+	BasicStats::matrix_span<double> matrix(cells.data(), 3, 2);
+	EXPECT_DOUBLE_EQ(BasicStats::mean(matrix.column(1)), 20.0);
+	EXPECT_DOUBLE_EQ(BasicStats::median(matrix.column(0)), 2.0);
+	EXPECT_DOUBLE_EQ(BasicStats::coeff_of_variation(matrix.column(1)), BasicStats::coeff_of_variation(std::vector<double>{ 10.0, 20.0, 30.0 }));
+	BasicStats::strided_span<const double> column = matrix.column(1);
+	EXPECT_EQ(column.stride(), 2 * sizeof(double));
+	EXPECT_DOUBLE_EQ(BasicStats::sum(column), 60.0);
+}
+
+TEST(BasicStatsTests, ColumnStatisticsOverRowMajorMatrix) {
+	const size_t rows = 2001, cols = 11;
+	std::vector<double> cells(rows * cols);
+	std::mt19937 gen(7);
+	std::uniform_real_distribution<double> dist(-50.0, 50.0);
+	for (double& cell : cells) cell = dist(gen);
+	BasicStats::matrix_span<const double> matrix(cells, cols);
+	EXPECT_EQ(matrix.rows(), rows);
+
+	std::vector<double> means = BasicStats::column_means(matrix);
+	std::vector<double> stdevs = BasicStats::column_stdevs(matrix);
+	std::vector<double> medians = BasicStats::column_medians(matrix);
+	std::vector<double> p90 = BasicStats::column_percentiles(matrix, 90.0);
+	std::vector<BasicStats::Moments> moments = BasicStats::column_moments(matrix);
+	ASSERT_EQ(means.size(), cols);
+	for (size_t c = 0; c < cols; ++c) {
+		std::vector<double> column(rows);
+		for (size_t r = 0; r < rows; ++r) column[r] = cells[r * cols + c];
+		EXPECT_NEAR(means[c], BasicStats::mean(column), 1e-9);
+		EXPECT_NEAR(stdevs[c], BasicStats::stdev(column), 1e-9);
+		EXPECT_DOUBLE_EQ(medians[c], BasicStats::median(column));
+		EXPECT_DOUBLE_EQ(p90[c], BasicStats::percentile(column, 90.0));
+		EXPECT_EQ(moments[c].count(), rows);
+		EXPECT_EQ(moments[c].max(), *std::max_element(column.begin(), column.end()));
+	}
+
+	// A sub-matrix view skips the first column of every row.
+	BasicStats::matrix_span<const double> right(cells.data() + 1, rows, cols - 1, cols);
+	EXPECT_NEAR(BasicStats::column_variances(right)[0], BasicStats::variance(BasicStats::strided_span<const double>(matrix.column(1))), 1e-9);
+	EXPECT_THROW(BasicStats::matrix_span<const double>(cells, 7), std::invalid_argument);
+	EXPECT_THROW(BasicStats::column_percentiles(matrix, 101.0), std::out_of_range);
+
+	// A mutable view reduces the same way as a const one.
+	BasicStats::matrix_span<double> writable(cells.data(), rows, cols);
+	EXPECT_EQ(BasicStats::column_means(writable), means);
+	EXPECT_EQ(BasicStats::column_stdevs<double>(writable), stdevs);
+	EXPECT_EQ(BasicStats::column_medians(writable), medians);
+	EXPECT_EQ(BasicStats::column_percentiles(writable, 90.0), p90);
+	BasicStats::matrix_span<const double> viewed = writable;
+	EXPECT_EQ(viewed.row_stride(), cols);
+}
+
+TEST(BasicStatsTests, FrequencyTableModeAndTopK) {
+	std::vector<int> small = { 3, 1, 3, 2, 3, 1, -4 };
+	BasicStats::FrequencyTable<int> table;
+	table.push(small);
+	EXPECT_FALSE(table.hashed());
+	EXPECT_EQ(table.mode(), 3);
+	EXPECT_EQ(table.distinct(), 4u);
+	EXPECT_EQ(table.frequency(1), 2u);
+	EXPECT_EQ(table.frequency(99), 0u);
+	EXPECT_EQ(table.table().front(), std::make_pair(-4, uint64_t(1)));
+	std::vector<std::pair<int, uint64_t>> top = table.top_k(2);
+	ASSERT_EQ(top.size(), 2u);
+	EXPECT_EQ(top[0], std::make_pair(3, uint64_t(3)));
+	EXPECT_EQ(top[1], std::make_pair(1, uint64_t(2)));
+	EXPECT_NEAR(table.entropy(), -(3.0 / 7 * std::log2(3.0 / 7) + 2.0 / 7 * std::log2(2.0 / 7) + 2 * (1.0 / 7) * std::log2(1.0 / 7)), 1e-12);
+
+	// A value far outside the flat range moves the table to the hash table without losing counts.
+	table.push(1 << 30);
+	table.push(1 << 30);
+	table.push(1 << 30);
+	EXPECT_TRUE(table.hashed());
+	EXPECT_EQ(table.mode(), 3);
+	EXPECT_EQ(table.frequency(1 << 30), 3u);
+	EXPECT_EQ(table.count(), 10u);
+
+	std::vector<int64_t> wide(200000);
+	for (size_t i = 0; i < wide.size(); ++i) wide[i] = static_cast<int64_t>((i * 7919) % 1000) * 1000003;
+	std::map<int64_t, uint64_t> expected;
+	for (int64_t value : wide) ++expected[value];
+	BasicStats::FrequencyTable<int64_t> merged = BasicStats::frequency_table(wide);
+	EXPECT_EQ(merged.count(), wide.size());
+	EXPECT_EQ(merged.distinct(), expected.size());
+	EXPECT_EQ(BasicStats::distinct_count(wide), expected.size());
+	EXPECT_EQ(BasicStats::mode(wide), 0);
+	for (const auto& entry : merged.table()) EXPECT_EQ(entry.second, expected[entry.first]);
+
+	std::vector<std::string> labels = { "get", "put", "get", "delete", "get", "put" };
+	EXPECT_EQ(BasicStats::mode(labels), "get");
+	EXPECT_EQ(BasicStats::frequency_table(labels).top_k(5).size(), 3u);
+	EXPECT_EQ(BasicStats::mode(std::vector<int>()), 0);
+}
+
+TEST(BasicStatsTests, FrequencyTableCountsNaNAsOneValue) {
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	std::vector<double> values = { 1.5, nan, 2.5, nan, 1.5, nan, -0.5 };
+	BasicStats::FrequencyTable<double> table;
+	table.push(values);
+	table.push(nan);
+	EXPECT_EQ(table.count(), 8u);
+	EXPECT_EQ(table.distinct(), 4u);
+	EXPECT_EQ(table.frequency(nan), 4u);
+	EXPECT_EQ(table.frequency(1.5), 2u);
+	EXPECT_TRUE(std::isnan(table.mode()));
+
+	std::vector<std::pair<double, uint64_t>> sorted = table.table();
+	ASSERT_EQ(sorted.size(), 4u);
+	EXPECT_EQ(sorted[0].first, -0.5);
+	EXPECT_EQ(sorted[2].first, 2.5);
+	EXPECT_TRUE(std::isnan(sorted[3].first));
+	EXPECT_EQ(sorted[3].second, 4u);
+	std::vector<std::pair<double, uint64_t>> top = table.top_k(2);
+	ASSERT_EQ(top.size(), 2u);
+	EXPECT_TRUE(std::isnan(top[0].first));
+	EXPECT_EQ(top[1], std::make_pair(1.5, uint64_t(2)));
+
+	BasicStats::FrequencyTable<double> other;
+	other.push(nan);
+	other.push(2.5);
+	table.merge(other);
+	EXPECT_EQ(table.frequency(nan), 5u);
+	EXPECT_EQ(table.distinct(), 4u);
+	EXPECT_EQ(BasicStats::distinct_count(std::vector<float>{ 1.0f, std::nanf(""), std::nanf(""), 1.0f }), 2u);
+}